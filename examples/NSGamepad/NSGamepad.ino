@@ -30,7 +30,26 @@
 // to use a pin for both a digital button and analog
 // axis. The pullup resistor will interfere with
 // the analog voltage.
-#include <Bounce2.h>
+#include <NSPinScan.h>
+#include <NSAxisCurve.h>
+#include <NSStick.h>
+#include <NSCalibration.h>
+#include <NSAnalogScan.h>
+#include <NSAxisFilter.h>
+
+// Set to 1 to capture button edges with pin change interrupts. The edges are
+// then taken into the report from the USB interrupt just before the NS polls,
+// so presses reach it however long loop() takes.
+#define PIN_INTERRUPTS 0
+
+// Milliseconds the buttons ignore their edges after a press or release is
+// reported. Above 0 each press is reported on its first edge instead of
+// after the contact settles. The D-pad keeps the 10 ms interval.
+#define EAGER_LOCKOUT 0
+
+// Set to 1 to smooth the stick axes as each report is built. Sticks at rest
+// stop jittering, moving sticks are followed without lag.
+#define STICK_FILTER 0
 
 #define NUM_BUTTONS 14
 const uint8_t BUTTON_PINS[NUM_BUTTONS] = {23, 22, 21, 20, 7, 18, 6, 19, 8, 12, 9, 13, 11, 10};
@@ -56,88 +75,140 @@ const uint8_t DPAD_MAP[16] = {
   NSGAMEPAD_DPAD_CENTERED,  // 1111 invalid
 };
 
-Bounce * buttons = new Bounce[NUM_BUTTONS];
-Bounce * dpad = new Bounce[NUM_DPAD];
+// All button and dPad pins are read and debounced together. Button i is
+// bit i, the dPad pins follow from bit NUM_BUTTONS.
+NSPinScan pins;
+#define BUTTON_BITS ((1 << NUM_BUTTONS) - 1)
+
+// Input range, deadzone, curve and output range of each analog stick axis.
+// The Y axes are inverted. Set deadzone and expo to taste. The ranges are
+// only the defaults for a Teensy with no saved calibration, see axisRead().
+enum { LeftX, LeftY, RightX, RightY, NUM_AXES };
+//                                inMin  inMax     center deadzone expo gain outMin outMax
+NSAxisShape axis_shapes[NUM_AXES] = {{128,   1024-128, 0,     0,       0,   0,   0,     255},
+                                     {128,   1024-128, 0,     0,       0,   0,   255,   0},
+                                     {128,   1024-128, 0,     0,       0,   0,   0,     255},
+                                     {128,   1024-128, 0,     0,       0,   0,   255,   0}};
+NSAxisCurve axis_curves[NUM_AXES];
+NSCalibration calibration;
+
+// Analog pin of each axis, converted continuously in the background
+const uint8_t AXIS_PINS[NUM_AXES] = {2, 3, 0, 1};         // A2, A3, A0, A1
+NSAnalogScan analog;
+
+// Each stick's X/Y pair together: a round deadzone for a drifting center
+// and, for square gates, the corners brought in to the circle.
+//                          deadzone outer square
+const NSStickShape STICK = {8,       95,   false};
+NSStick LeftStick, RightStick;
+
+#if STICK_FILTER
+// Adaptive low pass of each axis, stepped once per report. The cutoff is
+// 1 Hz at rest and rises by 0.1 Hz per count per second of stick speed.
+// setup() sets the rate from the polling interval the host chose.
+//                     rate minCutoff beta dCutoff
+NSFilterShape filter = {0,  100,      100, 100};
+NSAxisFilter axis_filters[NUM_AXES];
+#endif
 
 void setup() {
   // you can print to the Serial1 port while the NSGamepad is active!
   Serial1.begin(115200);
   Serial1.println("NSGamepad setup");
-  for (int i = 0; i < NUM_BUTTONS; i++) {
-    buttons[i].attach( BUTTON_PINS[i] , INPUT_PULLUP  );  //setup the bounce instance for the current button
-    buttons[i].interval(10);                              // interval in ms
-  }
-  for (int i = 0; i < NUM_DPAD; i++) {
-    dpad[i].attach( DPAD_PINS[i] , INPUT_PULLUP  );       //setup the bounce instance for the current button
-    dpad[i].interval(10);                                 // interval in ms
-  }
+  pins.attach(BUTTON_PINS, NUM_BUTTONS);
+  pins.attach(DPAD_PINS, NUM_DPAD);
+  pins.interval(10);                                      // interval in ms
+#if EAGER_LOCKOUT
+  pins.eager(BUTTON_BITS, EAGER_LOCKOUT);
+#endif
+#if PIN_INTERRUPTS
+  pins.useInterrupts(true);
+#endif
 
+  analog.begin(AXIS_PINS, NUM_AXES);
+  calibration.begin(axis_shapes, axis_curves, NUM_AXES);
+  LeftStick.begin(STICK);
+  RightStick.begin(STICK);
+#if STICK_FILTER
+  filter.rate = 1000000 / NSGamepad.interval();
+  for (int i = 0; i < NUM_AXES; i++) axis_filters[i].begin(filter);
+#endif
   // Sends a clean HID report to the host.
   NSGamepad.begin();
+#if PIN_INTERRUPTS
+  NSGamepad.useSOFSync(true);
+  NSGamepad.setHandleReportUpdate(update_report);
+#endif
+#if STICK_FILTER
+  NSGamepad.setHandleReportBuild(build_report);
+#endif
 }
 
-uint8_t dpad_bits = 0;
+// One scan, or the captured edges, and one debounce pass for all the pins.
+// Taps are stretched like any other change. Returns true if a pin changed.
+bool update_pins()
+{
+  if (!pins.update()) return false;
+  NSGamepad.applyChanges(pins.pressed() & BUTTON_BITS, pins.released() & BUTTON_BITS, NULL, 0);
+  if ((pins.pressed() | pins.released()) >> NUM_BUTTONS) {
+    NSGamepad.dPad(DPAD_MAP[pins.read() >> NUM_BUTTONS]);
+  }
+  return true;
+}
 
-typedef struct axis_t {
-  uint16_t adcMin;
-  uint16_t adcMax;
-  const uint8_t toMin;
-  const uint8_t toMax;
-} axis_t;
+#if PIN_INTERRUPTS
+// Runs just before each report is read for the NS, from the USB interrupt
+// with SOF sync, so the edges captured since the last report reach it.
+// While loop() is between beginUpdate() and commit() the pins wait for it.
+void update_report()
+{
+  if (NSGamepad.inUpdate()) return;
+  NSGamepad.beginUpdate();
+  update_pins();
+  NSGamepad.commit();
+}
+#endif
 
-axis_t LeftX = {
-  128, 1024-128, 0, 255
-};
-axis_t LeftY = {
-  128, 1024-128, 255, 0
-};
-axis_t RightX = {
-  128, 1024-128, 0, 255
-};
-axis_t RightY = {
-  128, 1024-128, 255, 0
-};
+#if STICK_FILTER
+// Runs as each report is queued. The axes are filtered on their way to the
+// NS.
+void build_report(void *report)
+{
+  HID_NSGamepadReport_Data_t *r = (HID_NSGamepadReport_Data_t *)report;
+  r->leftXAxis = axis_filters[LeftX].apply(r->leftXAxis);
+  r->leftYAxis = axis_filters[LeftY].apply(r->leftYAxis);
+  r->rightXAxis = axis_filters[RightX].apply(r->rightXAxis);
+  r->rightYAxis = axis_filters[RightY].apply(r->rightYAxis);
+}
+#endif
 
 // Dynamically determine the pot limits because of my craptastic
-// analog sticks.
-uint8_t axisRead(int analogPin, struct axis_t &ax)
+// analog sticks. The limits and rest positions are kept in EEPROM, so the
+// sticks are calibrated from power up, and sweeping them once widens the
+// range for good. Reading an axis is one table lookup, calibration.loop()
+// rebuilds the tables and saves the calibration in the background.
+// The ADC converts the pins by itself, so this does not wait for it either.
+uint8_t axisRead(int axis)
 {
-  uint16_t x = analogRead(analogPin);
-  if (x > ax.adcMax) ax.adcMax = x;
-  if (x < ax.adcMin) ax.adcMin = x;
-  return map(x, ax.adcMin, ax.adcMax, ax.toMin, ax.toMax);
+  return calibration.read(axis, analog.read(axis));
 }
 
 void loop() {
-  for (int i = 0; i < NUM_BUTTONS; i++) {
-    // Update the Bounce instance
-    buttons[i].update();
-    // Button fell means button pressed
-    if ( buttons[i].fell() ) {
-      NSGamepad.press(i);
-    }
-    else if ( buttons[i].rose() ) {
-      NSGamepad.release(i);
-    }
-  }
-
-  for (unsigned i = 0; i < sizeof(DPAD_PINS); i++) {
-    // Update the Bounce instance
-    dpad[i].update();
-    // Button fell means button pressed
-    if ( dpad[i].fell() ) {
-      dpad_bits |= (1 << i);
-    }
-    else if ( dpad[i].rose() ) {
-      dpad_bits &= ~(1 << i);
-    }
-  }
-  NSGamepad.dPad(DPAD_MAP[dpad_bits]);
+  // All changes below reach the NS in the same report
+  NSGamepad.beginUpdate();
+  update_pins();
 
-  NSGamepad.leftYAxis(axisRead(3, LeftY));
-  NSGamepad.leftXAxis(axisRead(2, LeftX));
-  NSGamepad.rightYAxis(axisRead(1, RightY));
-  NSGamepad.rightXAxis(axisRead(0, RightX));
+  uint8_t x = axisRead(LeftX), y = axisRead(LeftY);
+  LeftStick.apply(x, y);
+  NSGamepad.leftXAxis(x);
+  NSGamepad.leftYAxis(y);
+  x = axisRead(RightX), y = axisRead(RightY);
+  RightStick.apply(x, y);
+  NSGamepad.rightXAxis(x);
+  NSGamepad.rightYAxis(y);
+  NSGamepad.commit();
 
   NSGamepad.loop();
+  analog.update();
+  calibration.loop();
 }
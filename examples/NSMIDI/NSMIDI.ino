@@ -437,6 +437,8 @@ const uint8_t KEYCODE2BUTTON[] = {
 
 void setup() {
   NSGamepad.begin();
+  // A note shorter than one report is still sent as a press and a release
+  NSGamepad.usePulseStretch(true);
 
   // Wait 1.5 seconds before turning on USB Host.  If connected USB devices
   // use too much power, Teensy at least completes USB enumeration, which
@@ -35,12 +35,31 @@
 // input pins.
 #define ANALOG_JOYSTICKS  0
 
+// Set to 1 to capture button edges with pin change interrupts. The report is
+// then built from the USB interrupt just before the NS polls, taking the
+// edges through the merge, so presses reach it however long loop() takes.
+#define PIN_INTERRUPTS 0
+
+// Milliseconds the buttons ignore their edges after a press or release is
+// reported. Above 0 each press is reported on its first edge instead of
+// after the contact settles. The D-pad keeps the 10 ms interval.
+#define EAGER_LOCKOUT 0
+
+// Set to 1 to smooth the stick axes as each report is built. Sticks at rest
+// stop jittering, moving sticks are followed without lag.
+#define STICK_FILTER 0
+
 #include "USBHost_t36.h"
+#include <NSGamepadMap.h>
+#include <NSGamepadMerge.h>
+#include <NSCalibration.h>
+#include <NSAnalogScan.h>
+#include <NSAxisFilter.h>
 // Configure the number of buttons.  Be careful not
 // to use a pin for both a digital button and analog
 // axis. The pullup resistor will interfere with
 // the analog voltage.
-#include <Bounce2.h>
+#include <NSPinScan.h>
 
 #define NUM_BUTTONS 14
 const uint8_t BUTTON_PINS[NUM_BUTTONS] = {23, 22, 21, 20, 7, 18, 6, 19, 8, 12, 9, 13, 11, 10};
@@ -54,7 +73,7 @@ USBHIDParser hid2(myusb);
 USBHIDParser hid3(myusb);
 USBHIDParser hid4(myusb);
 #define COUNT_JOYSTICKS 4
-JoystickController joysticks[COUNT_JOYSTICKS](myusb);
+JoystickController joysticks[COUNT_JOYSTICKS] = {myusb, myusb, myusb, myusb};
 
 USBDriver *drivers[] = {&hub1, &joysticks[0], &joysticks[1], &joysticks[2], &joysticks[3], &hid1, &hid2, &hid3, &hid4};
 #define CNT_DEVICES (sizeof(drivers)/sizeof(drivers[0]))
@@ -66,35 +85,6 @@ USBHIDInput *hiddrivers[] = {&joysticks[0], &joysticks[1], &joysticks[2], &joyst
 const char * hid_driver_names[CNT_DEVICES] = {"joystick[0H]", "joystick[1H]", "joystick[2H]", "joystick[3H]"};
 bool hid_driver_active[CNT_DEVICES] = {false};
 
-uint8_t joystick_left_trigger_value[COUNT_JOYSTICKS] = {0};
-uint8_t joystick_right_trigger_value[COUNT_JOYSTICKS] = {0};
-uint64_t joystick_full_notify_mask = (uint64_t) - 1;
-
-// Convert direction pad numbers to (X,Y) values. X and Y range from 0..255.
-// The direction pad returns 0..F where 0xF is the idle/centered position.
-// X=128, Y=128 center position.
-const struct dPad2dir {
-  uint8_t xDir;
-  uint8_t yDir;
-} dPad2dir_table[16] = {
-  {128, 0},   /* 0 Up */
-  {255, 0},   /* 1 Up Right */
-  {255, 128}, /* 2 Right */
-  {255, 255}, /* 3 Down Right */
-  {128, 255}, /* 4 Down */
-  {0, 255},   /* 5 Down Left */
-  {0, 128},   /* 6 Left */
-  {0, 0},     /* 7 Up Left */
-  {128, 128}, /* 8 Invalid */
-  {128, 128}, /* 9 Invalid */
-  {128, 128}, /* 10 Invalid */
-  {128, 128}, /* 11 Invalid */
-  {128, 128}, /* 12 Invalid */
-  {128, 128}, /* 13 Invalid */
-  {128, 128}, /* 14 Invalid */
-  {128, 128}  /* 15 Centered */
-};
-
 // Convert the 4 direction buttons to direction pad values
 const uint8_t DPAD_MAP[16] = {
                             // LDRU
@@ -116,8 +106,59 @@ const uint8_t DPAD_MAP[16] = {
   NSGAMEPAD_DPAD_CENTERED,  // 1111 invalid
 };
 
-Bounce * buttons = new Bounce[NUM_BUTTONS];
-Bounce * dpad = new Bounce[NUM_DPAD];
+// All button and dPad pins are read and debounced together. Button i is
+// bit i, the dPad pins follow from bit NUM_BUTTONS.
+NSPinScan pins;
+#define BUTTON_BITS ((1 << NUM_BUTTONS) - 1)
+
+// Input range, deadzone, curve and output range of each analog stick axis.
+// The Y axes are inverted. Set deadzone and expo to taste. The ranges are
+// only the defaults for a Teensy with no saved calibration, see axisRead().
+enum { LeftX, LeftY, RightX, RightY, NUM_AXES };
+//                                inMin  inMax     center deadzone expo gain outMin outMax
+NSAxisShape axis_shapes[NUM_AXES] = {{128,   1024-128, 0,     0,       0,   0,   0,     255},
+                                     {128,   1024-128, 0,     0,       0,   0,   255,   0},
+                                     {128,   1024-128, 0,     0,       0,   0,   0,     255},
+                                     {128,   1024-128, 0,     0,       0,   0,   255,   0}};
+NSAxisCurve axis_curves[NUM_AXES];
+NSCalibration calibration;
+
+// Analog pin of each axis, converted continuously in the background
+const uint8_t AXIS_PINS[NUM_AXES] = {2, 3, 0, 1};         // A2, A3, A0, A1
+NSAnalogScan analog;
+
+// Each stick's X/Y pair together: a round deadzone for a drifting center
+// and, for square gates, the corners brought in to the circle.
+//                          deadzone outer square
+const NSStickShape STICK = {8,       95,   false};
+NSStick LeftStick, RightStick;
+
+// Each controller and the Teensy pins are a source of their own. The merge
+// holds every button any of them holds, takes each axis from the source
+// furthest off center and adds up the dPads. Use NSMERGE_PRIORITY for a
+// field to let the first source not at rest own it instead.
+#define GPIO_SOURCE COUNT_JOYSTICKS
+NSGamepadMerge merge;
+
+#if STICK_FILTER
+// Adaptive low pass of each axis, stepped once per report. The cutoff is
+// 1 Hz at rest and rises by 0.1 Hz per count per second of stick speed.
+// setup() sets the rate from the polling interval the host chose.
+//                     rate minCutoff beta dCutoff
+NSFilterShape filter = {0,  100,      100, 100};
+NSAxisFilter axis_filters[NUM_AXES];
+#endif
+
+// Every button change and axis of each controller, recorded by the USB host
+// driver, so a tap between two loop() passes is not lost. The event
+// callback marks the controllers with new input for loop().
+#define JOYSTICK_EVENTS 64
+JoystickController::event_t joystick_events[COUNT_JOYSTICKS][JOYSTICK_EVENTS];
+volatile uint8_t joysticks_pending = 0;
+
+// Output report from the NS, saved by the USB interrupt for loop()
+volatile bool output_pending = false;
+uint8_t output_report[NSGAMEPAD_OUTPUT_SIZE];
 
 //=============================================================================
 // Setup
@@ -128,92 +169,70 @@ void setup()
   Serial1.begin(115200);
   // Sends a clean HID report to the NS.
   Serial1.println("\n\nNS Gamepad");
-  for (int i = 0; i < NUM_BUTTONS; i++) {
-    buttons[i].attach( BUTTON_PINS[i] , INPUT_PULLUP  );  //setup the bounce instance for the current button
-    buttons[i].interval(10);                              // interval in ms
-  }
-  for (int i = 0; i < NUM_DPAD; i++) {
-    dpad[i].attach( DPAD_PINS[i] , INPUT_PULLUP  );       //setup the bounce instance for the current button
-    dpad[i].interval(10);                                 // interval in ms
+  pins.attach(BUTTON_PINS, NUM_BUTTONS);
+  pins.attach(DPAD_PINS, NUM_DPAD);
+  pins.interval(10);                                      // interval in ms
+#if EAGER_LOCKOUT
+  pins.eager(BUTTON_BITS, EAGER_LOCKOUT);
+#endif
+#if PIN_INTERRUPTS
+  pins.useInterrupts(true);
+#endif
+#if ANALOG_JOYSTICKS
+  analog.begin(AXIS_PINS, NUM_AXES);
+  calibration.begin(axis_shapes, axis_curves, NUM_AXES);
+#endif
+  LeftStick.begin(STICK);
+  RightStick.begin(STICK);
+#if STICK_FILTER
+  filter.rate = 1000000 / NSGamepad.interval();
+  for (int i = 0; i < NUM_AXES; i++) axis_filters[i].begin(filter);
+#endif
+  merge.begin(COUNT_JOYSTICKS + 1);
+  for (int joystick_index = 0; joystick_index < COUNT_JOYSTICKS; joystick_index++) {
+    joysticks[joystick_index].attachQueue(joystick_events[joystick_index], JOYSTICK_EVENTS);
+    joysticks[joystick_index].attachEvent(handle_joystick_event);
   }
   NSGamepad.begin();
+  // Taps shorter than one report still reach the NS
+  NSGamepad.usePulseStretch(true);
+  NSGamepad.setHandleOutputReport(handle_output_report);
+#if PIN_INTERRUPTS
+  NSGamepad.useSOFSync(true);
+  NSGamepad.setHandleReportUpdate(update_report);
+#endif
+#if STICK_FILTER
+  NSGamepad.setHandleReportBuild(build_report);
+#endif
   Serial1.println("\n\nUSB Host Joystick");
   myusb.begin();
 }
 
-uint32_t update_buttons(uint32_t buttons, uint32_t buttons_old,
-    const uint8_t *button_map, size_t button_map_size)
-{
-  for (uint8_t i = 0; i < button_map_size; i++) {
-    uint8_t button_out;
-    if (button_map == NULL) {
-      button_out = i;
-    }
-    else {
-      button_out = button_map[i];
-    }
-    if (button_out != 255) {
-      uint32_t button_bit_mask = 1 << i;
-      if ((buttons & button_bit_mask) && !(buttons_old & button_bit_mask)) {
-        // button fell/press (0->1 transition)
-        NSGamepad.press(button_out);
-      }
-      else if (!(buttons & button_bit_mask) && (buttons_old & button_bit_mask)) {
-        // button rose/release (1->0 transition)
-        NSGamepad.release(button_out);
-      }
-    }
-  }
-  return buttons;
-}
-
-// Process input events from a Hori Horipad Nintendo Switch compatible gamepad.
-// This is mostly just a pass through since the USB device port emulates the
-// same device.
-void handle_horipad(int joystick_index)
-{
-  uint64_t axis_mask = joysticks[joystick_index].axisMask();
-
-  for (uint8_t i = 0; axis_mask != 0; i++, axis_mask >>= 1) {
-    if (axis_mask & 1) {
-      int ax = joysticks[joystick_index].getAxis(i);
-      switch (i) {
-        case 0:
-          NSGamepad.leftXAxis(ax);
-          break;
-        case 1:
-          NSGamepad.leftYAxis(ax);
-          break;
-        case 2:
-          NSGamepad.rightXAxis(ax);
-          break;
-        case 5:
-          NSGamepad.rightYAxis(ax);
-          break;
-        case 9:
-          NSGamepad.dPad(ax);
-          break;
-        default:
-          break;
-      }
-    }
-  }
-
-  static uint32_t buttons_old = 0;
-  buttons_old = update_buttons(joysticks[joystick_index].getButtons(),
-      buttons_old, NULL, 14);
-}
+//=============================================================================
+// Controller profiles
+//=============================================================================
+// Each controller is found by its USB vendor and product IDs. NSGamepadMap
+// compiles its profile into lookup tables when it connects. Add a profile to
+// support another controller.
+
+// Hori Horipad Nintendo Switch compatible gamepad. This is mostly just a pass
+// through since the USB device port emulates the same device.
+const NSMapAxis HORIPAD_AXES[] = {
+  {0, NSMAP_LEFT_X, 255},
+  {1, NSMAP_LEFT_Y, 255},
+  {2, NSMAP_RIGHT_X, 255},
+  {5, NSMAP_RIGHT_Y, 255},
+};
 
-// Process input events from Logitech Extreme 3D Pro flight control stick
+// Logitech Extreme 3D Pro flight control stick
 //
 // The Logitech Extreme 3D Pro joystick (also known as a flight stick)
 // has a large X,Y,twist joystick with an 8-way hat switch on top.
-// This maps the large X,Y axes to the gamepad right thumbstick and
-// the hat switch to the gamepad left thumbstick. There are six
+// This maps the large X,Y axes to the gamepad left thumbstick and
+// the hat switch to the gamepad right thumbstick. There are six
 // buttons on the top of the stick and six on the base. The twist
-// used to control the stick buttons. Each gamepad thumbstick is
-// also a button. For example, clicking the right thumbstick enables
-// stealth mode in Zelda:BOTW.
+// also controls the right thumbstick X axis, to look left and right.
+// While the twist is centered the hat controls it.
 //
 // Map LE3DP button numbers to NS gamepad buttons
 //    LE3DP buttons
@@ -228,79 +247,35 @@ void handle_horipad(int joystick_index)
 //
 //    7 9 11
 //    6 8 10
-void handle_le3dp(int joystick_index)
-{
-  static const uint8_t BUTTON_MAP[12] = {
-    NSButton_A,             // Front trigger
-    NSButton_B,             // Side thumb trigger
-    NSButton_X,             // top large left
-    NSButton_Y,             // top large right
-    NSButton_LeftTrigger,   // top small left
-    NSButton_RightTrigger,  // top small right
-    NSButton_Minus,
-    NSButton_Plus,
-    NSButton_Capture,
-    NSButton_Home,
-    NSButton_LeftThrottle,
-    NSButton_RightThrottle
-  };
-
-  uint64_t axis_mask = joysticks[joystick_index].axisMask();
-  static uint8_t twist_old = 0;
-
-  for (uint8_t i = 0; axis_mask != 0; i++, axis_mask >>= 1) {
-    if (axis_mask & 1) {
-      int ax = joysticks[joystick_index].getAxis(i);
-      switch (i) {
-        case 0:
-          // Big stick X axis
-          NSGamepad.leftXAxis(map(ax, 0, 0x3FF, 0, 255));
-          break;
-        case 1:
-          // Big stick Y axis
-          NSGamepad.leftYAxis(map(ax, 0, 0x3FF, 0, 255));
-          break;
-        case 5:
-          // Twist axis maps to right stick X (look left and right)
-          NSGamepad.rightXAxis(ax);
-          twist_old = ax;
-          break;
-        case 6:
-          // Slider
-          break;
-        case 9:
-          // direction pad (hat switch)
-          // Convert direction to X,Y for right thumbstick
-          // If the twist axis is not centered(128), let twist control
-          // the X direction (look left and right). If the twist axis
-          // is centered, the hat controls look left and right.
-          if (twist_old == 128) {
-            NSGamepad.rightXAxis(dPad2dir_table[ax].xDir);
-          }
-          NSGamepad.rightYAxis(dPad2dir_table[ax].yDir);
-          break;
-        default:
-          break;
-      }
-    }
-  }
-
-  static uint32_t buttons_old = 0;
-  buttons_old = update_buttons(joysticks[joystick_index].getButtons(),
-      buttons_old, BUTTON_MAP, sizeof(BUTTON_MAP));
-}
+const uint8_t LE3DP_BUTTONS[12] = {
+  NSButton_A,             // Front trigger
+  NSButton_B,             // Side thumb trigger
+  NSButton_X,             // top large left
+  NSButton_Y,             // top large right
+  NSButton_LeftTrigger,   // top small left
+  NSButton_RightTrigger,  // top small right
+  NSButton_Minus,
+  NSButton_Plus,
+  NSButton_Capture,
+  NSButton_Home,
+  NSButton_LeftThrottle,
+  NSButton_RightThrottle
+};
+const NSMapAxis LE3DP_AXES[] = {
+  {0, NSMAP_LEFT_X, 0x3FF},   // Big stick X axis, 10 bits
+  {1, NSMAP_LEFT_Y, 0x3FF},   // Big stick Y axis
+  {5, NSMAP_RIGHT_X, 255},    // Twist, look left and right
+};
 
-// Process input events from Thrustermaster T.16000 flight control stick
+// Thrustmaster T.16000M flight control stick
 //
-// Map T16K button numbers to NS gamepad buttons
 // The Thrustmaster T.16000M ambidextrous joystick (also known as a flight stick)
 // has a large X,Y,twist joystick with an 8-way hat switch on top.
-// This function maps the large X,Y axes to the gamepad right thumbstick and
-// the hat switch to the gamepad left thumbstick. There are four
-// buttons on the top of the stick and 12 on the base. The twist
-// used to control the stick buttons. Each gamepad thumbstick is
-// also a button. For example, clicking the right thumbstick enables
-// stealth mode in Zelda:BOTW.
+// This maps the large X,Y axes to the gamepad left thumbstick and
+// the hat switch and twist to the gamepad right thumbstick, the same as
+// the LE3DP. There are four buttons on the top of the stick and 12 on
+// the base. Each gamepad thumbstick is also a button. For example,
+// clicking the right thumbstick enables stealth mode in Zelda:BOTW.
 //
 //    Map T16K button numbers to NS gamepad buttons
 //    T16K buttons
@@ -322,243 +297,252 @@ void handle_le3dp(int joystick_index)
 //       11 15
 //    12 14
 //    13
-void handle_t16k(int joystick_index)
+const uint8_t T16K_BUTTONS[16] = {
+  NSButton_A,             // Trigger
+  NSButton_B,             // Top center
+  NSButton_X,             // Top Left
+  NSButton_Y,             // Top Right
+  NSButton_LeftTrigger,   // Base left 4
+  NSButton_RightTrigger,  // Base left 5
+  NSButton_Minus,         // Base left 6
+  NSButton_Plus,          // Base left 7
+  NSButton_Capture,       // Base left 8
+  NSButton_Home,          // Base left 9
+  NSButton_LeftStick,     // Base right 10
+  NSButton_RightStick,    // Base right 11
+  NSButton_LeftThrottle,  // Base right 12
+  NSButton_RightThrottle, // Base right 13
+  NSButton_Reserved1,     // Base right 14
+  NSButton_Reserved2      // Base right 15
+};
+const NSMapAxis T16K_AXES[] = {
+  {0, NSMAP_LEFT_X, 0x3FFF},  // Big stick X axis, 14 bits
+  {1, NSMAP_LEFT_Y, 0x3FFF},  // Big stick Y axis
+  {5, NSMAP_RIGHT_X, 255},    // Twist, look left and right
+};
+
+// Two DragonRise arcade joysticks make one NS gamepad
+//
+// The Dragon Rise arcade joystick has 1 stick and up to 10 buttons. Two are
+// required to make 1 gamepad with 2 sticks plus 18 buttons. The first one
+// found is the right side of the gamepad, the second the left side. The
+// left side has the direction pad buttons.
+const uint8_t DRAGONRISE_BUTTONS_RIGHT[12] = {
+  NSButton_RightThrottle,
+  NSButton_RightTrigger,
+  NSButton_Plus,
+  NSButton_A,
+  NSButton_B,
+  NSButton_X,
+  NSButton_Y,
+  NSButton_RightStick,
+  NSButton_Home,
+  NSButton_Reserved2,
+  NSButton_Reserved2,
+  NSButton_Reserved2
+};
+const uint8_t DRAGONRISE_BUTTONS_LEFT[12] = {
+  NSButton_LeftThrottle,
+  NSButton_LeftTrigger,
+  NSButton_Minus,
+  NSMAP_DPAD_UP,
+  NSMAP_DPAD_RIGHT,
+  NSMAP_DPAD_DOWN,
+  NSMAP_DPAD_LEFT,
+  NSButton_LeftStick,
+  NSButton_Capture,
+  NSButton_Reserved1,
+  NSButton_Reserved1,
+  NSButton_Reserved1
+};
+const NSMapAxis DRAGONRISE_AXES_RIGHT[] = {
+  {0, NSMAP_RIGHT_X, 255},
+  {1, NSMAP_RIGHT_Y, 255},
+};
+const NSMapAxis DRAGONRISE_AXES_LEFT[] = {
+  {0, NSMAP_LEFT_X, 255},
+  {1, NSMAP_LEFT_Y, 255},
+};
+
+#define COUNT_OF(a) (sizeof(a)/sizeof(a[0]))
+const NSMapProfile PROFILES[] = {
+  // Hori Horipad, hat switch on axis 9
+  {0x0F0D, 0x00C1, NULL, 14, HORIPAD_AXES, COUNT_OF(HORIPAD_AXES), 9, NSMAP_DPAD},
+  // Logitech Extreme 3D Pro
+  {0x046D, 0xC215, LE3DP_BUTTONS, COUNT_OF(LE3DP_BUTTONS),
+    LE3DP_AXES, COUNT_OF(LE3DP_AXES), 9, NSMAP_RIGHT_STICK},
+  // Thrustmaster T.16000M FCS
+  {0x044F, 0xB10A, T16K_BUTTONS, COUNT_OF(T16K_BUTTONS),
+    T16K_AXES, COUNT_OF(T16K_AXES), 9, NSMAP_RIGHT_STICK},
+  // DragonRise fightsticks, right side then left side
+  {0x0079, 0x0006, DRAGONRISE_BUTTONS_RIGHT, COUNT_OF(DRAGONRISE_BUTTONS_RIGHT),
+    DRAGONRISE_AXES_RIGHT, COUNT_OF(DRAGONRISE_AXES_RIGHT), NSMAP_UNUSED, 0},
+  {0x0079, 0x0006, DRAGONRISE_BUTTONS_LEFT, COUNT_OF(DRAGONRISE_BUTTONS_LEFT),
+    DRAGONRISE_AXES_LEFT, COUNT_OF(DRAGONRISE_AXES_LEFT), NSMAP_UNUSED, 0},
+};
+
+NSGamepadMap joystick_maps[COUNT_JOYSTICKS];
+
+// Compile the profile of a newly connected controller. A controller gets the
+// lowest instance no other controller with the same IDs holds, so with a pair
+// of fightsticks the one plugged back in takes the side that was left free.
+// Each controller keeps its own state in its map, and a controller that goes
+// away releases what it was holding.
+void update_joystick_maps()
 {
-  static const uint8_t BUTTON_MAP[16] = {
-    NSButton_A,             // Trigger
-    NSButton_B,             // Top center
-    NSButton_X,             // Top Left
-    NSButton_Y,             // Top Right
-    NSButton_LeftTrigger,   // Base left 4
-    NSButton_RightTrigger,  // Base left 5
-    NSButton_Minus,         // Base left 6
-    NSButton_Plus,          // Base left 7
-    NSButton_Capture,       // Base left 8
-    NSButton_Home,          // Base left 9
-    NSButton_LeftStick,     // Base right 10
-    NSButton_RightStick,    // Base right 11
-    NSButton_LeftThrottle,  // Base right 12
-    NSButton_RightThrottle, // Base right 13
-    NSButton_Reserved1,     // Base right 14
-    NSButton_Reserved2      // Base right 15
-  };
-  uint64_t axis_mask = joysticks[joystick_index].axisMask();
-  static uint8_t twist_old = 0;
-
-  for (uint8_t i = 0; axis_mask != 0; i++, axis_mask >>= 1) {
-    if (axis_mask & 1) {
-      int ax = joysticks[joystick_index].getAxis(i);
-      switch (i) {
-        case 0:
-          // Big stick X axis
-          NSGamepad.leftXAxis(map(ax, 0, 0x3FFF, 0, 255));
-          break;
-        case 1:
-          // Big stick Y axis
-          NSGamepad.leftYAxis(map(ax, 0, 0x3FFF, 0, 255));
-          break;
-        case 5:
-          // Twist axis maps to right stick X (look left and right)
-          NSGamepad.rightXAxis(ax);
-          twist_old = ax;
-          break;
-        case 6:
-          // Slider
-          break;
-        case 9:
-          // direction pad (hat switch)
-          // Convert direction to X,Y for right thumbstick
-          // If the twist axis is not centered(128), let twist control
-          // the X direction (look left and right). If the twist axis
-          // is centered, the hat controls look left and right.
-          if (twist_old == 128) {
-            NSGamepad.rightXAxis(dPad2dir_table[ax].xDir);
-          }
-          NSGamepad.rightYAxis(dPad2dir_table[ax].yDir);
-          break;
-        default:
-          break;
+  // release the instances of controllers that went away before handing any out
+  for (int joystick_index = 0; joystick_index < COUNT_JOYSTICKS; joystick_index++) {
+    NSGamepadMap &jmap = joystick_maps[joystick_index];
+    JoystickController &joystick = joysticks[joystick_index];
+    // a different controller may have taken the slot between two loop() passes
+    if (jmap && (!joystick || jmap.idVendor() != joystick.idVendor() ||
+        jmap.idProduct() != joystick.idProduct())) {
+      jmap.end();
+    }
+  }
+  for (int joystick_index = 0; joystick_index < COUNT_JOYSTICKS; joystick_index++) {
+    NSGamepadMap &jmap = joystick_maps[joystick_index];
+    JoystickController &joystick = joysticks[joystick_index];
+    if (jmap || !joystick) continue;
+    uint32_t held = 0;
+    for (int i = 0; i < COUNT_JOYSTICKS; i++) {
+      if (joystick_maps[i] && joystick_maps[i].idVendor() == joystick.idVendor() &&
+          joystick_maps[i].idProduct() == joystick.idProduct()) {
+        held |= 1 << joystick_maps[i].instance();
       }
     }
+    jmap.begin(PROFILES, COUNT_OF(PROFILES), joystick.idVendor(),
+        joystick.idProduct(), __builtin_ctz(~held));
+    jmap.mergeInto(&merge, joystick_index);
   }
-
-  static uint32_t buttons_old = 0;
-  buttons_old = update_buttons(joysticks[joystick_index].getButtons(),
-      buttons_old, BUTTON_MAP, sizeof(BUTTON_MAP));
 }
 
-// Process input events from two DragonRise joysticks. Each joystick has
-// one stick and up to 12 buttons. Two are required to create a gamepad.
-//
-// Map two Dragon Rise arcade joysticks to one NS gamepad The Dragon Rise
-// arcade joystick has 1 stick and up to 10 buttons. Two are required to make 1
-// gamepad with 2 sticks plus 18 buttons. The dragonFirst flag determines which
-// joystick is the left or right side of the gamepad.
-//
-void handle_dragonrise(int joystick_index)
+// Runs in USB host processing for each report that changed something. It
+// only notes which controller moved, so loop() visits just those.
+void handle_joystick_event(JoystickController &joystick, uint64_t changed_axes,
+    uint32_t pressed, uint32_t released)
 {
-  // Left side of gamepad
-  static const uint8_t BUTTON_MAP_LEFT[12] = {
-    NSButton_LeftThrottle,
-    NSButton_LeftTrigger,
-    NSButton_Minus,
-    255,    // DPAD Up
-    255,    // DPAD Right
-    255,    // DPAD Down
-    255,    // DPAD Left
-    NSButton_LeftStick,
-    NSButton_Capture,
-    NSButton_Reserved1,
-    NSButton_Reserved1,
-    NSButton_Reserved1
-  };
-  // Right side of gamepad
-  static const uint8_t BUTTON_MAP_RIGHT[12] = {
-    NSButton_RightThrottle,
-    NSButton_RightTrigger,
-    NSButton_Plus,
-    NSButton_A,
-    NSButton_B,
-    NSButton_X,
-    NSButton_Y,
-    NSButton_RightStick,
-    NSButton_Home,
-    NSButton_Reserved2,
-    NSButton_Reserved2,
-    NSButton_Reserved2
-  };
-
-  static uint8_t dragonFirst = 255;
-  uint64_t axis_mask = joysticks[joystick_index].axisMask();
-
-  if (joystick_index < dragonFirst) dragonFirst = joystick_index;
-  for (uint8_t i = 0; axis_mask != 0; i++, axis_mask >>= 1) {
-    if (axis_mask & 1) {
-      int ax = joysticks[joystick_index].getAxis(i);
-      switch (i) {
-        case 0:
-          if (dragonFirst == joystick_index)
-            NSGamepad.rightXAxis(ax);
-          else
-            NSGamepad.leftXAxis(ax);
-          break;
-        case 1:
-          if (dragonFirst == joystick_index)
-            NSGamepad.rightYAxis(ax);
-          else
-            NSGamepad.leftYAxis(ax);
-          break;
-        default:
-          break;
-      }
-    }
-  }
+  joysticks_pending |= 1 << (&joystick - joysticks);
+}
 
-  static uint8_t dpad_bits = 0;
-  static uint32_t buttons_old_left = 0;
-  static uint32_t buttons_old_right = 0;
-  uint32_t buttons = joysticks[joystick_index].getButtons();
-  uint8_t button_out;
-  if (joystick_index == dragonFirst) {
-    buttons_old_right = update_buttons(buttons, buttons_old_right,
-        BUTTON_MAP_RIGHT, sizeof(BUTTON_MAP_RIGHT));
-  }
-  else {
-    buttons_old_left = update_buttons(buttons, buttons_old_left,
-        BUTTON_MAP_LEFT, sizeof(BUTTON_MAP_LEFT));
-    for (uint8_t i = 0; i < sizeof(BUTTON_MAP_LEFT); i++) {
-      button_out = BUTTON_MAP_LEFT[i];
-      if (button_out == 255) {  // direction pad button
-        uint8_t dpad_bit_mask = (1 << (i - 3));
-        if (buttons & (1 << i)) {
-          if ((dpad_bits & dpad_bit_mask) == 0) {
-            // button fell/press (0->1 transition)
-            dpad_bits |= dpad_bit_mask;
-            NSGamepad.dPad(DPAD_MAP[dpad_bits]);
-          }
-        }
-        else {
-          if ((dpad_bits & dpad_bit_mask) != 0) {
-            // button rose/release (1->0 transition)
-            dpad_bits &= ~dpad_bit_mask;
-            NSGamepad.dPad(DPAD_MAP[dpad_bits]);
-          }
-        }
-      }
-    }
+// Maps the recorded changes of the controllers that moved, in order
+void update_joysticks()
+{
+  __disable_irq();
+  uint8_t pending = joysticks_pending;
+  joysticks_pending = 0;
+  __enable_irq();
+  for (; pending; pending &= pending - 1) {
+    int joystick_index = __builtin_ctz(pending);
+    joystick_maps[joystick_index].updateEvents(joysticks[joystick_index]);
   }
 }
 
 /* ***** GPIO ******* */
-typedef struct axis_t {
-  uint16_t adcMin;
-  uint16_t adcMax;
-  const uint8_t toMin;
-  const uint8_t toMax;
-} axis_t;
-
-axis_t LeftX = {
-  128, 1024-128, 0, 255
-};
-axis_t LeftY = {
-  128, 1024-128, 255, 0
-};
-axis_t RightX = {
-  128, 1024-128, 0, 255
-};
-axis_t RightY = {
-  128, 1024-128, 255, 0
-};
-
 // Dynamically determine the pot limits because of my craptastic
-// analog sticks.
-uint8_t axisRead(int analogPin, struct axis_t &ax)
+// analog sticks. The limits and rest positions are kept in EEPROM, so the
+// sticks are calibrated from power up, and sweeping them once widens the
+// range for good. Reading an axis is one table lookup, calibration.loop()
+// rebuilds the tables and saves the calibration in the background.
+// The ADC converts the pins by itself, so this does not wait for it either.
+uint8_t axisRead(int axis)
 {
-  uint16_t x = analogRead(analogPin);
-  if (x > ax.adcMax) ax.adcMax = x;
-  if (x < ax.adcMin) ax.adcMin = x;
-  return map(x, ax.adcMin, ax.adcMax, ax.toMin, ax.toMax);
+  return calibration.read(axis, analog.read(axis));
 }
 
-void handle_gpio()
+#if STICK_FILTER
+// Runs as each report is queued, from the USB interrupt with SOF sync. The
+// axes are filtered on their way to the NS.
+void build_report(void *report)
 {
-  static uint8_t dpad_bits = 0;
-  for (int i = 0; i < NUM_BUTTONS; i++) {
-    // Update the Bounce instance
-    buttons[i].update();
-    // Button fell means button pressed
-    if ( buttons[i].fell() ) {
-      NSGamepad.press(i);
-    }
-    else if ( buttons[i].rose() ) {
-      NSGamepad.release(i);
-    }
-  }
+  HID_NSGamepadReport_Data_t *r = (HID_NSGamepadReport_Data_t *)report;
+  r->leftXAxis = axis_filters[LeftX].apply(r->leftXAxis);
+  r->leftYAxis = axis_filters[LeftY].apply(r->leftYAxis);
+  r->rightXAxis = axis_filters[RightX].apply(r->rightXAxis);
+  r->rightYAxis = axis_filters[RightY].apply(r->rightYAxis);
+}
+#endif
 
-  for (unsigned i = 0; i < sizeof(DPAD_PINS); i++) {
-    // Update the Bounce instance
-    dpad[i].update();
-    // Button fell means button pressed
-    if ( dpad[i].fell() ) {
-      dpad_bits |= (1 << i);
-      NSGamepad.dPad(DPAD_MAP[dpad_bits]);
-    }
-    else if ( dpad[i].rose() ) {
-      dpad_bits &= ~(1 << i);
-      NSGamepad.dPad(DPAD_MAP[dpad_bits]);
-    }
-  }
+// One scan, or the captured edges, and one debounce pass for all the pins.
+// The pins are a merge source like the controllers, so their taps are
+// stretched and their releases do not cancel a controller's hold. Returns
+// true if a pin changed.
+bool update_pins()
+{
+  if (!pins.update()) return false;
+  uint8_t report[NSGAMEPAD_REPORT_SIZE];
+  report[NSMERGE_DPAD] = DPAD_MAP[pins.read() >> NUM_BUTTONS];
+  merge.applyChanges(GPIO_SOURCE, pins.pressed() & BUTTON_BITS,
+      pins.released() & BUTTON_BITS, report, 1 << NSMERGE_DPAD);
+  return true;
+}
+
+#if PIN_INTERRUPTS
+// Runs just before each report is read for the NS, from the USB interrupt
+// with SOF sync. The pin edges captured since the last report go through
+// the merge into that report, so a press does not wait for loop(). While
+// loop() is between beginUpdate() and commit() the pins are left to its
+// handle_gpio().
+void update_report()
+{
+  if (NSGamepad.inUpdate() || !update_pins()) return;
+  NSGamepad.beginUpdate();
+  merge.update();
+  NSGamepad.commit();
+}
+#endif
 
-  // If nothing is connected to the analog input pins, analogRead returns
+void handle_gpio()
+{
+  update_pins();
+
+  // If nothing is connected to the analog input pins, the ADC returns
   // random garbage. Enable only when joysticks are connected.
 #if ANALOG_JOYSTICKS
-  NSGamepad.leftYAxis(axisRead(3, LeftY));
-  NSGamepad.leftXAxis(axisRead(2, LeftX));
-  NSGamepad.rightYAxis(axisRead(1, RightY));
-  NSGamepad.rightXAxis(axisRead(0, RightX));
+  uint8_t axes[NSGAMEPAD_REPORT_SIZE];
+  uint8_t x = axisRead(LeftX), y = axisRead(LeftY);
+  LeftStick.apply(x, y);
+  axes[NSMERGE_LEFT_X] = x;
+  axes[NSMERGE_LEFT_Y] = y;
+  x = axisRead(RightX), y = axisRead(RightY);
+  RightStick.apply(x, y);
+  axes[NSMERGE_RIGHT_X] = x;
+  axes[NSMERGE_RIGHT_Y] = y;
+  merge.applyChanges(GPIO_SOURCE, 0, 0, axes, (1 << NSMERGE_LEFT_X) |
+      (1 << NSMERGE_LEFT_Y) | (1 << NSMERGE_RIGHT_X) | (1 << NSMERGE_RIGHT_Y));
 #endif
 }
 
+//=============================================================================
+// Rumble and LEDs from the NS
+//=============================================================================
+// The NS sends the 8 byte vendor output report with SET_REPORT.  Bytes 0 and
+// 1 are forwarded as left and right rumble, bytes 2 to 4 as LED red, green
+// and blue.  The core only declares the report when NSGAMEPAD_OUTPUT_REPORT
+// is 1.  USBHost_t36 must not be called from the USB device interrupt, so
+// the handler only saves the report and loop() forwards it on its next pass.
+void handle_output_report(const uint8_t *data, uint32_t len)
+{
+  memset(output_report, 0, sizeof(output_report));
+  memcpy(output_report, data, len);
+  output_pending = true;
+}
+
+void forward_output_report()
+{
+  uint8_t report[NSGAMEPAD_OUTPUT_SIZE];
+
+  if (!output_pending) return;
+  __disable_irq();
+  memcpy(report, output_report, sizeof(report));
+  output_pending = false;
+  __enable_irq();
+  for (int joystick_index = 0; joystick_index < COUNT_JOYSTICKS; joystick_index++) {
+    joysticks[joystick_index].setRumble(report[0], report[1]);
+    joysticks[joystick_index].setLEDs(report[2], report[3], report[4]);
+  }
+}
+
 //=============================================================================
 // loop
 //=============================================================================
@@ -566,32 +550,21 @@ void loop()
 {
   myusb.Task();
   PrintDeviceListChanges();
+  forward_output_report();
 
-  for (int joystick_index = 0; joystick_index < COUNT_JOYSTICKS; joystick_index++) {
-    if (joysticks[joystick_index].available()) {
-      JoystickController::joytype_t joystickType = joysticks[joystick_index].joystickType();
-      switch (joystickType) {
-        case JoystickController::HORIPAD:
-          handle_horipad(joystick_index);
-          break;
-        case JoystickController::EXTREME3D: // Logitech Extreme 3D Pro
-          handle_le3dp(joystick_index);
-          break;
-        case JoystickController::T16000M: // Thrustmaster T.16000M
-          handle_t16k(joystick_index);
-          break;
-        case JoystickController::DRAGONRISE:
-          handle_dragonrise(joystick_index);
-          break;
-        default:
-          break;
-      }
-      joysticks[joystick_index].joystickDataClear();
-    } /* if joystick available */
-  } /* for joystick_index */
+  // Changes from all controllers reach the NS in the same report
+  NSGamepad.beginUpdate();
+  update_joystick_maps();
+  update_joysticks();
 
   handle_gpio();
+  merge.update();
+  NSGamepad.commit();
   NSGamepad.loop();
+#if ANALOG_JOYSTICKS
+  analog.update();
+  calibration.loop();
+#endif
 }
 
 //=============================================================================
@@ -0,0 +1,117 @@
+/* Teensy 3.6/4.1 plays a gamepad script into the Nintendo Switch
+
+   Select "NS Gamepad" from the "Tools > USB Type" menu
+
+   Plays script.nsg from the micro SD card over and over, for soak testing.
+   Each record of the script is applied on the exact USB poll it names.
+   Without a card the short script in flash below is played. Make scripts
+   with extras/nsscript/nsscript.py.
+*/
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <SD.h>
+#include <NSGamepadScript.h>
+
+#define SCRIPT_FILE "script.nsg"
+#ifdef BUILTIN_SDCARD
+#define SD_CS BUILTIN_SDCARD
+#else
+#define SD_CS 10    // SD card adapter on the SPI pins
+#endif
+// Playback ends when the Switch has not polled for this long
+#define POLL_TIMEOUT_MSEC 1000
+
+// Press A for 6 polls, hold the left stick right from poll 60 to 120, then
+// wait until poll 250.  Made by nsscript.py encode --c-array flash_script
+// from this text:
+//   0   buttons=0x0004
+//   6   buttons=0
+//   60  lx=255
+//   120 lx=128
+//   250
+const uint8_t flash_script[] PROGMEM = {
+    0x4e, 0x53, 0x47, 0x53, 0x01, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x04, 0x06, 0x01, 0x00, 0x36, 0x08, 0xff, 0x3c, 0x08, 0x80,
+    0x82, 0x01, 0x00,
+};
+
+NSScriptPlayer player;
+NSScriptMemory flash_source(flash_script, sizeof(flash_script));
+File script_file;
+NSScriptFile<File> file_source(script_file);
+bool have_card;
+uint32_t last_frame;
+elapsedMillis since_poll;
+
+void setup() {
+    Serial1.begin(115200);
+    Serial1.println("NSPlayback");
+    NSGamepad.begin();
+    have_card = SD.begin(SD_CS) && SD.exists(SCRIPT_FILE);
+    // give the Switch time to find the gamepad
+    delay(3000);
+}
+
+void start_playback() {
+    bool ok;
+    if (have_card) {
+        if (script_file) script_file.close();
+        script_file = SD.open(SCRIPT_FILE);
+        ok = player.begin(file_source);
+    }
+    else {
+        // back to the start of the script
+        flash_source = NSScriptMemory(flash_script, sizeof(flash_script));
+        ok = player.begin(flash_source);
+    }
+    last_frame = 0;
+    since_poll = 0;
+    if (!ok) {
+        Serial1.println("script not valid or USB not configured");
+        delay(1000);
+    }
+}
+
+void loop() {
+    // Frames are counted from the polls, so without them playback would
+    // wait forever
+    if (player.playing()) {
+        if (player.frame() != last_frame) {
+            last_frame = player.frame();
+            since_poll = 0;
+        }
+        else if (!usb_configuration || since_poll > POLL_TIMEOUT_MSEC) {
+            Serial1.println("USB polls stopped, playback ended");
+            player.end();
+        }
+    }
+    if (!player.task()) {
+        if (player.error()) Serial1.println("script read error");
+        if (player.lateCount()) {
+            Serial1.printf("%lu records played late\n", player.lateCount());
+        }
+        start_playback();
+    }
+}
@@ -0,0 +1,101 @@
+/* Teensy records every report the Nintendo Switch reads
+
+   Select "NS Gamepad" or "Serial + NS Gamepad" from the "Tools > USB Type"
+   menu.
+
+   Two buttons on pins 2 and 3 press A and B. Every report the Switch reads
+   is recorded to rec.nsg on the micro SD card. Without a card and with the
+   "Serial + NS Gamepad" USB type the recording is written to the USB serial
+   port instead, for example cat /dev/ttyACM0 > rec.nsg. Decode a recording
+   with extras/nsscript/nsscript.py decode rec.nsg or play it back with
+   examples/NSPlayback.
+*/
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <SD.h>
+#include <NSPinScan.h>
+#include <NSGamepadScript.h>
+
+#define RECORD_FILE "rec.nsg"
+#ifdef BUILTIN_SDCARD
+#define SD_CS BUILTIN_SDCARD
+#else
+#define SD_CS 10    // SD card adapter on the SPI pins
+#endif
+
+// The pins and the buttons they press
+#define NUM_BUTTONS 2
+const uint8_t BUTTON_PINS[NUM_BUTTONS] = {2, 3};
+const uint8_t BUTTONS[NUM_BUTTONS] = {NSButton_A, NSButton_B};
+NSPinScan pins;
+NSScriptRecorder recorder;
+File record_file;
+uint32_t last_flush;
+uint32_t last_dropped;
+
+void setup() {
+    Serial1.begin(115200);
+    Serial1.println("NSRecord");
+    pins.attach(BUTTON_PINS, NUM_BUTTONS);
+    pins.interval(10);                                  // interval in ms
+    if (SD.begin(SD_CS)) {
+        SD.remove(RECORD_FILE);
+        record_file = SD.open(RECORD_FILE, FILE_WRITE);
+    }
+    NSGamepad.begin();
+    recorder.begin();
+}
+
+void loop() {
+    NSGamepad.beginUpdate();
+    if (pins.update()) {
+        for (uint8_t i = 0; i < NUM_BUTTONS; i++) {
+            if (pins.pressed() & (1 << i)) NSGamepad.press(BUTTONS[i]);
+            if (pins.released() & (1 << i)) NSGamepad.release(BUTTONS[i]);
+        }
+    }
+    NSGamepad.commit();
+    NSGamepad.loop();
+
+    // Recording happens in the USB interrupt, writing it out happens here
+    if (record_file) {
+        // SD cards write whole 512 byte sectors, so wait for one
+        if (recorder.available() >= 512) recorder.drain(record_file);
+        if (millis() - last_flush > 1000) {
+            recorder.drain(record_file);
+            record_file.flush();
+            last_flush = millis();
+        }
+    }
+#if defined(CDC_DATA_INTERFACE)
+    else if (Serial.dtr()) {
+        recorder.drain(Serial);
+    }
+#endif
+    if (recorder.droppedCount() != last_dropped) {
+        last_dropped = recorder.droppedCount();
+        Serial1.printf("%lu reports dropped\n", last_dropped);
+    }
+}
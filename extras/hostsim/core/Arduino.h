@@ -0,0 +1,60 @@
+/* Host simulation stub of the Teensy Arduino.h / WProgram.h
+ *
+ * Provides what the NSGadget sketches and the NS gamepad core need to build
+ * on Linux.  Built with -DUSB_NSGAMEPAD against the Teensy 4 core headers.
+ */
+#ifndef hostsim_Arduino_h_
+#define hostsim_Arduino_h_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "core_pins.h"
+#include "usb_desc.h"
+#include "usb_nsgamepad.h"
+#include "hostsim.h"
+
+#ifdef __cplusplus
+
+static inline long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+	if (in_max == in_min) return out_min;
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class Print
+{
+public:
+	virtual size_t write(uint8_t b) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t count = 0;
+		while (size--) count += write(*buffer++);
+		return count;
+	}
+};
+
+// Serial output goes to stdout only when the simulation is verbose
+class HardwareSerial
+{
+public:
+	void begin(uint32_t baud) { (void)baud; }
+	size_t print(const char *s) { return out("%s", s); }
+	size_t print(long n) { return out("%ld", n); }
+	size_t println(void) { return out("\n"); }
+	size_t println(const char *s) { return out("%s\n", s); }
+	size_t println(long n) { return out("%ld\n", n); }
+	size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+private:
+	size_t out(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+};
+extern HardwareSerial Serial1;
+
+#endif // __cplusplus
+
+#endif
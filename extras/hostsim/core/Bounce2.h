@@ -0,0 +1,49 @@
+/* Host simulation stub of the Bounce2 library
+ *
+ * Same stable interval algorithm as Bounce2: a change is reported once the
+ * pin has held its new level for interval() milliseconds.
+ */
+#ifndef hostsim_Bounce2_h_
+#define hostsim_Bounce2_h_
+
+#include "Arduino.h"
+
+class Bounce
+{
+public:
+	void attach(int pin, int mode) {
+		this->pin = pin;
+		pinMode(pin, mode);
+		state = unstable = digitalRead(pin);
+		changed = false;
+		previous_millis = millis();
+	}
+	void interval(uint16_t interval_millis) {
+		this->interval_millis = interval_millis;
+	}
+	bool update(void) {
+		uint8_t current = digitalRead(pin);
+		changed = false;
+		if (current != unstable) {
+			previous_millis = millis();
+			unstable = current;
+		}
+		if (millis() - previous_millis >= interval_millis && state != unstable) {
+			state = unstable;
+			changed = true;
+		}
+		return changed;
+	}
+	bool read(void) { return state; }
+	bool fell(void) { return changed && !state; }
+	bool rose(void) { return changed && state; }
+private:
+	int pin = 0;
+	uint16_t interval_millis = 10;
+	uint32_t previous_millis = 0;
+	uint8_t state = HIGH;
+	uint8_t unstable = HIGH;
+	bool changed = false;
+};
+
+#endif
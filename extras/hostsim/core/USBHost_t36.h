@@ -0,0 +1,212 @@
+/* Host simulation stub of the USBHost_t36 library
+ *
+ * Only what the NSGadget sketches use.  A JoystickController is connected
+ * and fed by the simulation instead of a USB device, either directly with
+ * simInput() or from a script that USBHost::Task() plays back in time.
+ */
+#ifndef hostsim_USBHost_t36_h_
+#define hostsim_USBHost_t36_h_
+
+#include "Arduino.h"
+
+class USBHost
+{
+public:
+	void begin(void) { }
+	void Task(void);
+};
+
+class USBDriver
+{
+public:
+	virtual operator bool() { return connected_; }
+	uint16_t idVendor() { return idVendor_; }
+	uint16_t idProduct() { return idProduct_; }
+	const uint8_t *manufacturer() { return NULL; }
+	const uint8_t *product() { return NULL; }
+	const uint8_t *serialNumber() { return NULL; }
+protected:
+	bool connected_ = false;
+	uint16_t idVendor_ = 0;
+	uint16_t idProduct_ = 0;
+};
+
+class USBHIDInput
+{
+public:
+	virtual operator bool() { return false; }
+	virtual uint16_t idVendor() { return 0; }
+	virtual uint16_t idProduct() { return 0; }
+	virtual const uint8_t *manufacturer() { return NULL; }
+	virtual const uint8_t *product() { return NULL; }
+	virtual const uint8_t *serialNumber() { return NULL; }
+};
+
+class USBHub : public USBDriver
+{
+public:
+	USBHub(USBHost &host) { }
+};
+
+class USBHIDParser : public USBDriver
+{
+public:
+	USBHIDParser(USBHost &host) { }
+};
+
+class JoystickController : public USBDriver, public USBHIDInput
+{
+public:
+	JoystickController(USBHost &host) { }
+
+	enum { STANDARD_AXIS_COUNT = 10, ADDITIONAL_AXIS_COUNT = 54, TOTAL_AXIS_COUNT = (STANDARD_AXIS_COUNT+ADDITIONAL_AXIS_COUNT) };
+	typedef enum { UNKNOWN=0, PS3, PS4, XBOXONE, XBOX360, PS3_MOTION, SpaceNav, HORIPAD, DRAGONRISE, EXTREME3D, T16000M} joytype_t;
+
+	uint16_t idVendor() { return idVendor_; }
+	uint16_t idProduct() { return idProduct_; }
+	const uint8_t *manufacturer() { return NULL; }
+	const uint8_t *product() { return NULL; }
+	const uint8_t *serialNumber() { return NULL; }
+	operator bool() { return connected_; }
+
+	bool    available() { return joystickEvent; }
+	void    joystickDataClear() {
+		joystickEvent = false;
+		axis_changed_mask_ = 0;
+	}
+	uint32_t getButtons() { return buttons; }
+	int		getAxis(uint32_t index) { return (index < TOTAL_AXIS_COUNT) ? axis[index] : 0; }
+	uint64_t axisMask() {return axis_mask_;}
+	uint64_t axisChangedMask() { return axis_changed_mask_;}
+	void	 attachEvent(void (*f)(JoystickController &joystick, uint64_t changed_axes,
+				uint32_t pressed, uint32_t released)) {eventCallback = f;}
+	bool setRumble(uint8_t lValue, uint8_t rValue, uint8_t timeout=0xff) {
+		if (!connected_) return false;
+		sim_rumble[0] = lValue;
+		sim_rumble[1] = rValue;
+		return true;
+	}
+	bool setLEDs(uint8_t lr, uint8_t lg, uint8_t lb) {
+		if (!connected_) return false;
+		sim_leds[0] = lr;
+		sim_leds[1] = lg;
+		sim_leds[2] = lb;
+		return true;
+	}
+	joytype_t joystickType() {return joystickType_;}
+
+	enum { EVENT_BUTTONS = 0xFF };
+	typedef struct {
+		uint32_t time;
+		uint8_t axis;
+		int32_t value;
+	} event_t;
+	void	 attachQueue(event_t *events, uint16_t count) {
+		queue_ = nullptr;
+		if (events == nullptr || count == 0) return;
+		while (count & (count - 1)) count &= count - 1;
+		queue_mask_ = count - 1;
+		queue_head_ = queue_tail_ = 0;
+		queue_dropped_ = 0;
+		queue_buttons_ = buttons;
+		queue_ = events;
+	}
+	bool	 readEvent(event_t &event) {
+		if (queue_ == nullptr || queue_tail_ == queue_head_) return false;
+		event = queue_[queue_tail_++ & queue_mask_];
+		return true;
+	}
+	uint32_t droppedEvents() { return queue_dropped_; }
+
+	// simulation
+	void simConnect(uint16_t vid, uint16_t pid, joytype_t type) {
+		idVendor_ = vid;
+		idProduct_ = pid;
+		joystickType_ = type;
+		connected_ = true;
+	}
+	void simDisconnect(void) {
+		connected_ = false;
+		joystickType_ = UNKNOWN;
+		joystickEvent = false;
+		buttons = event_buttons_ = 0;
+		axis_mask_ = axis_changed_mask_ = 0;
+	}
+	// last values given to setRumble() and setLEDs()
+	uint8_t sim_rumble[2] = {0};
+	uint8_t sim_leds[3] = {0};
+	// New values for the axes in mask, as one HID input report.  Like the
+	// driver, an event queue or attachEvent() function gets the changes and
+	// takes the event.
+	void simInput(uint32_t new_buttons, uint64_t mask, const int *values) {
+		buttons = new_buttons;
+		for (uint32_t i = 0; i < STANDARD_AXIS_COUNT; i++) {
+			if (!(mask & (1ull << i))) continue;
+			if (axis[i] != values[i]) axis_changed_mask_ |= (1ull << i);
+			axis[i] = values[i];
+		}
+		axis_mask_ |= mask;
+		joystickEvent = true;
+		if (eventCallback == nullptr && queue_ == nullptr) return;
+		joystickEvent = false;
+		if (buttons == event_buttons_ && axis_changed_mask_ == 0) return;
+		if (queue_) {
+			uint32_t now = ARM_DWT_CYCCNT;
+			if (buttons != queue_buttons_) {
+				queue_buttons_ = buttons;
+				queue_event(now, EVENT_BUTTONS, buttons);
+			}
+			for (uint64_t changed = axis_changed_mask_; changed; changed &= changed - 1) {
+				uint8_t i = __builtin_ctzll(changed);
+				queue_event(now, i, axis[i]);
+			}
+		}
+		uint32_t pressed = buttons & ~event_buttons_;
+		uint32_t released = event_buttons_ & ~buttons;
+		event_buttons_ = buttons;
+		if (eventCallback) (*eventCallback)(*this, axis_changed_mask_, pressed, released);
+		axis_changed_mask_ = 0;
+	}
+
+private:
+	joytype_t joystickType_ = UNKNOWN;
+	volatile bool joystickEvent = false;
+	uint32_t buttons = 0;
+	int axis[TOTAL_AXIS_COUNT] = {0};
+	uint64_t axis_mask_ = 0;
+	uint64_t axis_changed_mask_ = 0;
+	void (*eventCallback)(JoystickController &joystick, uint64_t changed_axes,
+		uint32_t pressed, uint32_t released) = nullptr;
+	uint32_t event_buttons_ = 0;
+	void queue_event(uint32_t time, uint8_t axis, int32_t value) {
+		if ((uint16_t)(queue_head_ - queue_tail_) > queue_mask_) {
+			queue_dropped_++;
+			return;
+		}
+		event_t *e = &queue_[queue_head_++ & queue_mask_];
+		e->time = time;
+		e->axis = axis;
+		e->value = value;
+	}
+	event_t *queue_ = nullptr;
+	uint16_t queue_mask_ = 0;
+	uint16_t queue_head_ = 0;
+	uint16_t queue_tail_ = 0;
+	uint32_t queue_dropped_ = 0;
+	uint32_t queue_buttons_ = 0;
+};
+
+// One scripted HID input report, delivered by USBHost::Task() once the
+// simulated time reaches time_us
+typedef struct {
+	uint64_t time_us;
+	uint8_t joystick;
+	uint32_t buttons;
+	uint64_t axis_mask;
+	int axis[JoystickController::STANDARD_AXIS_COUNT];
+} sim_joystick_event_t;
+
+void sim_joystick_script(JoystickController *joysticks,
+	const sim_joystick_event_t *events, size_t count);
+
+#endif
@@ -0,0 +1,26 @@
+/* Host simulation stub of the Teensy avr/eeprom.h
+ *
+ * The EEPROM is a RAM array that keeps its contents across sim_reset(), like
+ * the real one keeps them across power cycles.
+ */
+#ifndef hostsim_eeprom_h_
+#define hostsim_eeprom_h_
+
+#include <stdint.h>
+
+#define E2END 0x437
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *buf, const void *addr, uint32_t len);
+void eeprom_write_block(const void *buf, void *addr, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
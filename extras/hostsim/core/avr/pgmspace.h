@@ -0,0 +1,10 @@
+/* Host simulation stub of the Teensy avr/pgmspace.h */
+#ifndef hostsim_pgmspace_h_
+#define hostsim_pgmspace_h_
+
+#define PROGMEM
+#define FLASHMEM
+#define DMAMEM
+#define FASTRUN
+
+#endif
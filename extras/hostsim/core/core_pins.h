@@ -0,0 +1,73 @@
+/* Host simulation stub of the Teensy core_pins.h
+ *
+ * Time is virtual.  It only moves when the simulation advances it, either
+ * directly or through yield() and delay(), so the USB interrupt work in
+ * hostsim.cpp runs at well defined points.  Interrupts never preempt the
+ * sketch, so __disable_irq() and __enable_irq() do nothing.
+ */
+#ifndef hostsim_core_pins_h_
+#define hostsim_core_pins_h_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+#define FALLING 2
+#define RISING 3
+#define CHANGE 4
+
+extern volatile uint32_t systick_millis_count;
+extern volatile uint32_t F_CPU_ACTUAL;
+
+uint32_t millis(void);
+uint32_t micros(void);
+uint32_t sim_cycles(void);
+void delay(uint32_t msec);
+void delayMicroseconds(uint32_t usec);
+void yield(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+uint8_t digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+int analogRead(uint8_t pin);
+// The simulated ADC always gives 10 bits
+static inline void analogReadResolution(unsigned int bits) { }
+static inline void analogReadAveraging(unsigned int num) { }
+
+// Pins 0 to 31 and 32 to 63 are two 32 bit GPIO ports, like the Teensy 4
+// fast GPIO ports read with portInputRegister()
+extern volatile uint32_t sim_gpio_port[2];
+#define portInputRegister(pin) (&sim_gpio_port[(pin) >> 5])
+#define digitalPinToBitMask(pin) ((uint32_t)1 << ((pin) & 31))
+
+// Runs the function from sim_digital_input() when the pin changes.  Only
+// CHANGE is simulated.
+#define digitalPinToInterrupt(pin) (pin)
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+#define ARM_DWT_CYCCNT (sim_cycles())
+
+static inline void delayNanoseconds(uint32_t nsec) { (void)nsec; }
+static inline void arm_dcache_flush_delete(void *addr, uint32_t size)
+{
+	(void)addr;
+	(void)size;
+}
+
+#define __disable_irq() do { } while (0)
+#define __enable_irq() do { } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
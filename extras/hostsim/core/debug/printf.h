@@ -0,0 +1,7 @@
+/* Host simulation stub of the Teensy 4 debug/printf.h, debug output is off */
+#ifndef hostsim_debug_printf_h_
+#define hostsim_debug_printf_h_
+
+#define printf(...)
+
+#endif
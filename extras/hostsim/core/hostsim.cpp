@@ -0,0 +1,393 @@
+/* Host simulation of the Teensy core pieces used by the NS gamepad
+ *
+ * See hostsim.h.  The USB side follows teensy4/usb.c closely enough for
+ * usb_nsgamepad.c: a start of frame every 1 ms (125 us at 480 Mbit/sec),
+ * then the host's IN token when its polling interval is due.
+ */
+#include "Arduino.h"
+#include "USBHost_t36.h"
+#include "usb_dev.h"
+#include "avr/eeprom.h"
+#include <vector>
+
+volatile uint32_t systick_millis_count = 0;
+volatile uint32_t F_CPU_ACTUAL = 600000000;
+volatile uint8_t usb_configuration = 0;
+volatile uint8_t usb_high_speed = 0;
+
+usb_nsgamepad_class NSGamepad;
+HardwareSerial Serial1;
+
+// How far yield() moves time, so code waiting on the USB makes progress
+#define YIELD_USEC 5
+
+static uint64_t now_us = 0;
+static uint64_t next_sof_us = 0;
+static uint32_t sof_ticks = 0;
+static uint32_t poll_interval = 0;
+static uint32_t poll_override = 0;
+static int sof_usage = 0;
+static int verbose = 0;
+
+static void (*tx_callback)(transfer_t *) = NULL;
+static transfer_t *tx_first = NULL;
+static transfer_t *tx_last = NULL;
+
+static std::vector<sim_report_t> reports;
+static uint32_t naks = 0;
+
+static uint8_t digital_pins[64];
+volatile uint32_t sim_gpio_port[2] = {0xFFFFFFFF, 0xFFFFFFFF};
+static void (*pin_interrupt[64])(void);
+static int analog_pins[64];
+
+static uint8_t eeprom[E2END + 1];
+static bool eeprom_ready = false;
+static uint32_t eeprom_writes = 0;
+
+static JoystickController *script_joysticks = NULL;
+static const sim_joystick_event_t *script_events = NULL;
+static size_t script_count = 0;
+static size_t script_next = 0;
+
+static uint32_t sof_usec(void)
+{
+	return usb_high_speed ? 125 : 1000;
+}
+
+static void host_poll(void)
+{
+	transfer_t *t = tx_first;
+	if (!t) {
+		naks++;
+		return;
+	}
+	tx_first = t->sim_next;
+	if (!tx_first) tx_last = NULL;
+	sim_report_t r;
+	r.time_us = now_us;
+	memcpy(r.data, t->sim_data, NSGAMEPAD_REPORT_SIZE);
+	reports.push_back(r);
+	t->status = 0;
+	if (tx_callback) tx_callback(t);
+}
+
+static void frame(void)
+{
+	if (!usb_configuration) return;
+	if (sof_usage) usb_nsgamepad_sof_callback();
+	uint32_t interval = poll_override ? poll_override : poll_interval;
+	if (++sof_ticks >= interval) {
+		sof_ticks = 0;
+		host_poll();
+	}
+}
+
+extern "C" {
+
+void sim_reset(void)
+{
+	now_us = 0;
+	next_sof_us = 0;
+	systick_millis_count = 0;
+	usb_configuration = 0;
+	usb_high_speed = 0;
+	sof_usage = 0;
+	poll_override = 0;
+	tx_first = tx_last = NULL;
+	reports.clear();
+	naks = 0;
+	memset(digital_pins, HIGH, sizeof(digital_pins));
+	sim_gpio_port[0] = sim_gpio_port[1] = 0xFFFFFFFF;
+	memset(pin_interrupt, 0, sizeof(pin_interrupt));
+	for (int i = 0; i < 64; i++) analog_pins[i] = 512;
+	script_joysticks = NULL;
+	script_events = NULL;
+	script_count = script_next = 0;
+}
+
+void sim_usb_configure(int high_speed)
+{
+	usb_high_speed = high_speed ? 1 : 0;
+	usb_configuration = 1;
+	poll_interval = high_speed ? (1 << (NSGAMEPAD_INTERVAL_480 - 1)) : NSGAMEPAD_INTERVAL_12;
+	sof_ticks = 0;
+	next_sof_us = now_us + sof_usec();
+	tx_first = tx_last = NULL;
+	usb_nsgamepad_configure();
+}
+
+void sim_usb_disconnect(void)
+{
+	usb_configuration = 0;
+	tx_first = tx_last = NULL;
+}
+
+void sim_host_set_report(const uint8_t *data, uint32_t len)
+{
+	// the control pipe is not modelled, the data stage completes at once
+	if (usb_configuration) usb_nsgamepad_output_report(data, len);
+}
+
+void sim_host_poll_interval(uint32_t ticks)
+{
+	poll_override = ticks;
+}
+
+void sim_advance_us(uint32_t usec)
+{
+	uint64_t end = now_us + usec;
+	while (usb_configuration && next_sof_us <= end) {
+		now_us = next_sof_us;
+		systick_millis_count = now_us / 1000;
+		next_sof_us += sof_usec();
+		frame();
+	}
+	now_us = end;
+	systick_millis_count = now_us / 1000;
+}
+
+uint64_t sim_time_us(void)
+{
+	return now_us;
+}
+
+uint32_t sim_report_count(void)
+{
+	return reports.size();
+}
+
+const sim_report_t *sim_report(uint32_t index)
+{
+	return (index < reports.size()) ? &reports[index] : NULL;
+}
+
+const sim_report_t *sim_last_report(void)
+{
+	return reports.empty() ? NULL : &reports.back();
+}
+
+void sim_report_clear(void)
+{
+	reports.clear();
+	naks = 0;
+}
+
+uint32_t sim_nak_count(void)
+{
+	return naks;
+}
+
+void sim_digital_input(uint8_t pin, uint8_t level)
+{
+	if (pin >= 64) return;
+	level = level ? HIGH : LOW;
+	if (digital_pins[pin] == level) return;
+	digital_pins[pin] = level;
+	if (level) sim_gpio_port[pin >> 5] |= digitalPinToBitMask(pin);
+	else sim_gpio_port[pin >> 5] &= ~digitalPinToBitMask(pin);
+	if (pin_interrupt[pin]) (*pin_interrupt[pin])();
+}
+
+void attachInterrupt(uint8_t pin, void (*function)(void), int mode)
+{
+	if (pin < 64 && mode == CHANGE) pin_interrupt[pin] = function;
+}
+
+void detachInterrupt(uint8_t pin)
+{
+	if (pin < 64) pin_interrupt[pin] = NULL;
+}
+
+void sim_analog_input(uint8_t pin, int value)
+{
+	if (pin >= 14 && pin < 64) pin -= 14; // A0 is pin 14
+	if (pin < 64) analog_pins[pin] = value;
+}
+
+void sim_verbose(int enable)
+{
+	verbose = enable;
+}
+
+// core_pins.h
+
+uint32_t millis(void)
+{
+	return now_us / 1000;
+}
+
+uint32_t micros(void)
+{
+	return now_us;
+}
+
+uint32_t sim_cycles(void)
+{
+	return now_us * (F_CPU_ACTUAL / 1000000);
+}
+
+void delay(uint32_t msec)
+{
+	sim_advance_us(msec * 1000);
+}
+
+void delayMicroseconds(uint32_t usec)
+{
+	sim_advance_us(usec);
+}
+
+void yield(void)
+{
+	sim_advance_us(YIELD_USEC);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+uint8_t digitalRead(uint8_t pin)
+{
+	return (pin < 64) ? digital_pins[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int analogRead(uint8_t pin)
+{
+	if (pin >= 14 && pin < 64) pin -= 14;
+	return (pin < 64) ? analog_pins[pin] : 0;
+}
+
+// usb_dev.h
+
+void usb_config_tx(uint32_t ep, uint32_t packet_size, int do_zlp, void (*cb)(transfer_t *))
+{
+	if (ep != NSGAMEPAD_ENDPOINT) return;
+	tx_callback = cb;
+	tx_first = tx_last = NULL;
+}
+
+void usb_prepare_transfer(transfer_t *transfer, const void *data, uint32_t len, uint32_t param)
+{
+	transfer->next = 1;
+	transfer->status = (len << 16) | (1<<7);
+	transfer->callback_param = param;
+	transfer->sim_data = data;
+	transfer->sim_next = NULL;
+}
+
+void usb_transmit(int endpoint_number, transfer_t *transfer)
+{
+	if (endpoint_number != NSGAMEPAD_ENDPOINT) return;
+	transfer->sim_next = NULL;
+	if (tx_last) {
+		tx_last->sim_next = transfer;
+	} else {
+		tx_first = transfer;
+	}
+	tx_last = transfer;
+}
+
+uint32_t usb_transfer_status(const transfer_t *transfer)
+{
+	return transfer->status;
+}
+
+void usb_start_sof_interrupts(int interface)
+{
+	sof_usage |= (1 << interface);
+}
+
+void usb_stop_sof_interrupts(int interface)
+{
+	sof_usage &= ~(1 << interface);
+}
+
+} // extern "C"
+
+// Arduino.h
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+	if (!verbose) return 0;
+	va_list args;
+	va_start(args, format);
+	int n = vprintf(format, args);
+	va_end(args);
+	return (n > 0) ? n : 0;
+}
+
+size_t HardwareSerial::out(const char *format, ...)
+{
+	if (!verbose) return 0;
+	va_list args;
+	va_start(args, format);
+	int n = vprintf(format, args);
+	va_end(args);
+	return (n > 0) ? n : 0;
+}
+
+// USBHost_t36.h
+
+void USBHost::Task(void)
+{
+	while (script_next < script_count && script_events[script_next].time_us <= now_us) {
+		const sim_joystick_event_t *e = script_events + script_next++;
+		script_joysticks[e->joystick].simInput(e->buttons, e->axis_mask, e->axis);
+	}
+}
+
+void sim_joystick_script(JoystickController *joysticks,
+	const sim_joystick_event_t *events, size_t count)
+{
+	script_joysticks = joysticks;
+	script_events = events;
+	script_count = count;
+	script_next = 0;
+}
+
+
+void sim_eeprom_erase(void)
+{
+	memset(eeprom, 0xFF, sizeof(eeprom));
+	eeprom_ready = true;
+	eeprom_writes = 0;
+}
+
+uint32_t sim_eeprom_writes(void)
+{
+	return eeprom_writes;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+	uint32_t a = (uintptr_t)addr;
+	if (!eeprom_ready) sim_eeprom_erase();
+	return (a <= E2END) ? eeprom[a] : 0xFF;
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+	uint32_t a = (uintptr_t)addr;
+	if (!eeprom_ready) sim_eeprom_erase();
+	if (a > E2END || eeprom[a] == value) return;
+	eeprom[a] = value;
+	eeprom_writes++;
+}
+
+void eeprom_read_block(void *buf, const void *addr, uint32_t len)
+{
+	uint8_t *p = (uint8_t *)buf;
+	const uint8_t *a = (const uint8_t *)addr;
+	while (len--) *p++ = eeprom_read_byte(a++);
+}
+
+void eeprom_write_block(const void *buf, void *addr, uint32_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	uint8_t *a = (uint8_t *)addr;
+	while (len--) eeprom_write_byte(a++, *p++);
+}
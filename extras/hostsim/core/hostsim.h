@@ -0,0 +1,58 @@
+/* Host simulation control for the NS gamepad core
+ *
+ * The simulation replaces the USB controller with a virtual endpoint and
+ * the host with a poller that reads one queued transfer every polling
+ * interval, taken from the bInterval of the negotiated speed like a real
+ * host would.  Every report the host reads is logged with its time.
+ */
+#ifndef hostsim_h_
+#define hostsim_h_
+
+#include <stdint.h>
+#include "usb_desc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint64_t time_us;
+	uint8_t data[NSGAMEPAD_REPORT_SIZE];
+} sim_report_t;
+
+// Time 0, USB not configured, inputs idle and the report log empty
+void sim_reset(void);
+// Host enumerated the device at 12 Mbit/sec (0) or 480 Mbit/sec (1)
+void sim_usb_configure(int high_speed);
+void sim_usb_disconnect(void);
+// Override the host polling period, in frames or microframes
+void sim_host_poll_interval(uint32_t sof_ticks);
+
+void sim_advance_us(uint32_t usec);
+uint64_t sim_time_us(void);
+
+uint32_t sim_report_count(void);
+const sim_report_t *sim_report(uint32_t index);
+const sim_report_t *sim_last_report(void);
+void sim_report_clear(void);
+// Host polls that found no report waiting
+uint32_t sim_nak_count(void);
+// Host sends an output report with a SET_REPORT control transfer
+void sim_host_set_report(const uint8_t *data, uint32_t len);
+
+void sim_digital_input(uint8_t pin, uint8_t level);
+void sim_analog_input(uint8_t pin, int value);
+
+// EEPROM back to erased, all 0xFF
+void sim_eeprom_erase(void);
+// Bytes written to the EEPROM that changed its contents
+uint32_t sim_eeprom_writes(void);
+
+// Print Serial1 output to stdout
+void sim_verbose(int enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
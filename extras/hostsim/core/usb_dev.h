@@ -0,0 +1,45 @@
+/* Host simulation stub of the Teensy 4 usb_dev.h
+ *
+ * Transfers queued with usb_transmit() wait on a virtual endpoint until the
+ * simulated host polls it.  See hostsim.h.
+ */
+#ifndef hostsim_usb_dev_h_
+#define hostsim_usb_dev_h_
+
+#include "usb_desc.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct transfer_struct transfer_t;
+struct transfer_struct {
+	uint32_t next;
+	volatile uint32_t status;
+	uint32_t pointer0;
+	uint32_t pointer1;
+	uint32_t pointer2;
+	uint32_t pointer3;
+	uint32_t pointer4;
+	uint32_t callback_param;
+	// host pointers do not fit in pointer0
+	const void *sim_data;
+	transfer_t *sim_next;
+};
+
+extern volatile uint8_t usb_configuration;
+extern volatile uint8_t usb_high_speed;
+
+void usb_config_tx(uint32_t ep, uint32_t packet_size, int do_zlp, void (*cb)(transfer_t *));
+void usb_prepare_transfer(transfer_t *transfer, const void *data, uint32_t len, uint32_t param);
+void usb_transmit(int endpoint_number, transfer_t *transfer);
+uint32_t usb_transfer_status(const transfer_t *transfer);
+void usb_start_sof_interrupts(int interface);
+void usb_stop_sof_interrupts(int interface);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,451 @@
+/* NS gamepad report path regression tests and benchmark, see Makefile */
+#include "Arduino.h"
+#include "USBHost_t36.h"
+#include "sim_test.h"
+#include <time.h>
+
+// from examples/NSPassthru
+void setup();
+void loop();
+extern JoystickController joysticks[];
+
+int checks = 0;
+int failures = 0;
+
+const HID_NSGamepadReport_Data_t *last_report(void)
+{
+	const sim_report_t *r = sim_last_report();
+	return r ? (const HID_NSGamepadReport_Data_t *)r->data : NULL;
+}
+
+void start(void)
+{
+	sim_reset();
+	sim_usb_configure(0);
+	NSGamepad.begin();
+	sim_advance_us(10000);
+	sim_report_clear();
+}
+
+// run a sketch style loop, calling fn every step_us
+void run(uint32_t usec, uint32_t step_us, void (*fn)(void))
+{
+	for (uint32_t t = 0; t < usec; t += step_us) {
+		if (fn) fn();
+		sim_advance_us(step_us);
+	}
+}
+
+static void gamepad_loop(void)
+{
+	NSGamepad.loop();
+}
+
+static void test_write(void)
+{
+	sim_reset();
+	sim_usb_configure(0);
+	NSGamepad.begin();
+	sim_advance_us(10000);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r != NULL);
+	if (!r) return;
+	CHECK(r->buttons == 0);
+	CHECK(r->dPad == NSGAMEPAD_DPAD_CENTERED);
+	CHECK(r->leftXAxis == 0x80 && r->leftYAxis == 0x80);
+	CHECK(r->rightXAxis == 0x80 && r->rightYAxis == 0x80);
+
+	NSGamepad.press(NSButton_A);
+	NSGamepad.write();
+	sim_advance_us(10000);
+	r = last_report();
+	CHECK(r->buttons == (1 << NSButton_A));
+}
+
+static void test_loop_period(void)
+{
+	start();
+	run(100000, 100, gamepad_loop);
+	// one report per polling interval
+	uint32_t expect = 100000 / NSGamepad.interval();
+	CHECK(sim_report_count() >= expect - 1 && sim_report_count() <= expect);
+}
+
+static void test_interval(void)
+{
+	start();
+	CHECK(NSGamepad.interval() == NSGAMEPAD_INTERVAL_12 * 1000);
+	sim_usb_configure(1);
+	CHECK(NSGamepad.interval() == (1u << (NSGAMEPAD_INTERVAL_480 - 1)) * 125);
+	// the host polls at the negotiated rate, loop() keeps up
+	sim_advance_us(10000);
+	sim_report_clear();
+	run(10000, 25, gamepad_loop);
+	uint32_t expect = 10000 / NSGamepad.interval();
+	CHECK(sim_report_count() >= expect - 1 && sim_report_count() <= expect);
+}
+
+static void test_sof_sync(void)
+{
+	start();
+	NSGamepad.useSOFSync(true);
+	run(100000, 100, NULL);
+	uint32_t count = sim_report_count();
+	uint32_t expect = 100000 / NSGamepad.interval();
+	CHECK(count >= expect - 1 && count <= expect);
+	for (uint32_t i = 2; i < count; i++) {
+		CHECK(sim_report(i)->time_us - sim_report(i - 1)->time_us == NSGamepad.interval());
+	}
+	// a change reaches the host within one polling interval
+	NSGamepad.leftXAxis(10);
+	uint64_t changed = sim_time_us();
+	run(20000, 100, NULL);
+	for (uint32_t i = count; i < sim_report_count(); i++) {
+		const sim_report_t *r = sim_report(i);
+		if (((const HID_NSGamepadReport_Data_t *)r->data)->leftXAxis == 10) {
+			CHECK(r->time_us - changed <= NSGamepad.interval());
+			break;
+		}
+	}
+	CHECK(last_report()->leftXAxis == 10);
+	NSGamepad.useSOFSync(false);
+}
+
+static void test_nowait(void)
+{
+	start();
+	int queued = 0;
+	while (NSGamepad.tryWrite() == NSGAMEPAD_SEND_QUEUED && queued < 100) queued++;
+	CHECK(queued > 0 && queued < 100);
+	CHECK(NSGamepad.tryWrite() == NSGAMEPAD_SEND_BUSY);
+	sim_usb_disconnect();
+	CHECK(NSGamepad.tryWrite() == NSGAMEPAD_SEND_NOT_CONFIGURED);
+}
+
+static volatile int transmit_complete_count = 0;
+static void transmit_complete(void)
+{
+	transmit_complete_count++;
+}
+
+static void test_transmit_complete(void)
+{
+	start();
+	transmit_complete_count = 0;
+	NSGamepad.setHandleTransmitComplete(transmit_complete);
+	NSGamepad.write();
+	NSGamepad.write();
+	sim_advance_us(20000);
+	CHECK(transmit_complete_count == 2);
+	NSGamepad.setHandleTransmitComplete(NULL);
+}
+
+static void test_latest_wins(void)
+{
+	start();
+	NSGamepad.useLatestWins(true);
+	uint32_t superseded = NSGamepad.supersededCount();
+	for (int i = 0; i < 10; i++) {
+		NSGamepad.leftXAxis(i);
+		NSGamepad.write();
+	}
+	CHECK(NSGamepad.supersededCount() - superseded == 8);
+	sim_advance_us(20000);
+	CHECK(sim_report_count() == 2);
+	CHECK(last_report()->leftXAxis == 9);
+	NSGamepad.useLatestWins(false);
+}
+
+static void test_commit(void)
+{
+	start();
+	NSGamepad.useSOFSync(true);
+	NSGamepad.beginUpdate();
+	NSGamepad.leftXAxis(10);
+	run(20000, 100, NULL);
+	CHECK(last_report()->leftXAxis == 0x80);
+	NSGamepad.leftYAxis(20);
+	NSGamepad.commit();
+	run(10000, 100, NULL);
+	CHECK(last_report()->leftXAxis == 10);
+	CHECK(last_report()->leftYAxis == 20);
+	NSGamepad.useSOFSync(false);
+}
+
+// buttons of the reports the host read from index on
+static int report_buttons(uint32_t index, uint16_t *buttons, int max)
+{
+	int n = 0;
+	for (uint32_t i = index; i < sim_report_count() && n < max; i++) {
+		buttons[n++] = ((const HID_NSGamepadReport_Data_t *)sim_report(i)->data)->buttons;
+	}
+	return n;
+}
+
+static void test_pulse_stretch(void)
+{
+	uint16_t b[8];
+	start();
+	NSGamepad.usePulseStretch(true);
+	run(20000, 100, gamepad_loop);
+
+	// a tap between two reports, and one inside a single update, are each
+	// sent pressed for one report
+	uint32_t first = sim_report_count();
+	NSGamepad.press(NSButton_A);
+	NSGamepad.release(NSButton_A);
+	NSGamepad.beginUpdate();
+	NSGamepad.press(NSButton_B);
+	NSGamepad.release(NSButton_B);
+	NSGamepad.commit();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(report_buttons(first, b, 3) == 3);
+	CHECK(b[0] == ((1 << NSButton_A) | (1 << NSButton_B)) && b[1] == 0 && b[2] == 0);
+
+	// a plain press is not delayed and a held button stays held
+	first = sim_report_count();
+	NSGamepad.press(NSButton_X);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(report_buttons(first, b, 3) == 3);
+	CHECK(b[0] == (1 << NSButton_X) && b[1] == b[0] && b[2] == b[0]);
+
+	// a second tap while the release of the first is still due does not
+	// hold the release back more than one report
+	first = sim_report_count();
+	NSGamepad.press(NSButton_Y);
+	NSGamepad.release(NSButton_Y);
+	run(NSGamepad.interval(), 100, gamepad_loop);
+	NSGamepad.press(NSButton_Y);
+	NSGamepad.release(NSButton_Y);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(report_buttons(first, b, 4) == 4);
+	uint16_t y = 1 << NSButton_Y;
+	CHECK((b[0] & y) && !(b[1] & y) && !(b[2] & y) && !(b[3] & y));
+	CHECK(last_report()->buttons == (1 << NSButton_X));
+
+	// a tap committed across a transmit: pressed in an update while a
+	// report goes out, released and committed after
+	first = sim_report_count();
+	NSGamepad.beginUpdate();
+	NSGamepad.press(NSButton_Y);
+	run(NSGamepad.interval(), 100, gamepad_loop);
+	NSGamepad.release(NSButton_Y);
+	NSGamepad.commit();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	int taps = 0;
+	for (int i = report_buttons(first, b, 8) - 1; i >= 0; i--) {
+		if (b[i] & y) taps++;
+	}
+	CHECK(taps == 1 && last_report()->buttons == (1 << NSButton_X));
+
+	// a press committed just before a transmit and released just after
+	// is sent for one report, then released
+	first = sim_report_count();
+	NSGamepad.press(NSButton_Y);
+	NSGamepad.write();
+	NSGamepad.release(NSButton_Y);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	taps = 0;
+	for (int i = report_buttons(first, b, 8) - 1; i >= 0; i--) {
+		if (b[i] & y) taps++;
+	}
+	CHECK(taps == 1 && last_report()->buttons == (1 << NSButton_X));
+
+	// without stretching the tap is lost
+	NSGamepad.usePulseStretch(false);
+	first = sim_report_count();
+	NSGamepad.press(NSButton_A);
+	NSGamepad.release(NSButton_A);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(report_buttons(first, b, 3) == 3);
+	CHECK(b[0] == (1 << NSButton_X) && b[1] == b[0] && b[2] == b[0]);
+}
+
+static const sim_joystick_event_t t16k_script[] = {
+	//  time  joy  buttons   axes        X       Y       -  -  -  twist  -  -  -  hat
+	{  1000,  0,   0x0001,   0x223,   { 0x3FFF, 0,      0, 0, 0, 128,   0, 0, 0, 15 } },
+	{ 30000,  0,   0x0000,   0x003,   { 0x2000, 0x3FFF, 0, 0, 0, 0,     0, 0, 0, 0 } },
+};
+
+static void test_passthru_t16k(void)
+{
+	sim_reset();
+	sim_usb_configure(0);
+	setup();
+	joysticks[0].simConnect(0x044F, 0xB10A, JoystickController::T16000M);
+	sim_joystick_script(joysticks, t16k_script, 1);
+	run(20000, 100, loop);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->buttons == (1 << NSButton_A));
+	CHECK(r->leftXAxis == 255 && r->leftYAxis == 0);
+	CHECK(r->rightXAxis == 128 && r->rightYAxis == 128);
+	sim_joystick_script(joysticks, t16k_script + 1, 1);
+	run(40000, 100, loop);
+	r = last_report();
+	CHECK(r->buttons == 0);
+	CHECK(r->leftXAxis == (0x2000 * 255 + 0x3FFF / 2) / 0x3FFF);
+	CHECK(r->leftYAxis == 255);
+	joysticks[0].simDisconnect();
+}
+
+// A pair of DragonRise fightsticks map to the right then the left side.  A
+// stick plugged back in takes the side that was left free, whichever slot
+// the USB host gives it.
+static void test_passthru_instance(void)
+{
+	static const int high[JoystickController::STANDARD_AXIS_COUNT] = {255};
+	static const int low[JoystickController::STANDARD_AXIS_COUNT] = {64};
+	sim_reset();
+	sim_usb_configure(0);
+	setup();
+	joysticks[0].simConnect(0x0079, 0x0006, JoystickController::UNKNOWN);
+	joysticks[1].simConnect(0x0079, 0x0006, JoystickController::UNKNOWN);
+	run(20000, 100, loop);
+	joysticks[0].simInput(0, 1, high);
+	joysticks[1].simInput(0, 1, low);
+	run(20000, 100, loop);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->rightXAxis == 255 && r->leftXAxis == 64);
+
+	// the right side stick goes away and comes back in another slot
+	joysticks[0].simDisconnect();
+	run(20000, 100, loop);
+	r = last_report();
+	CHECK(r->rightXAxis == 128 && r->leftXAxis == 64);
+	joysticks[2].simConnect(0x0079, 0x0006, JoystickController::UNKNOWN);
+	run(20000, 100, loop);
+	joysticks[2].simInput(0, 1, high);
+	run(20000, 100, loop);
+	r = last_report();
+	CHECK(r->rightXAxis == 255 && r->leftXAxis == 64);
+
+	// and the left side one comes back in the slot the right side one left
+	joysticks[1].simDisconnect();
+	run(20000, 100, loop);
+	r = last_report();
+	CHECK(r->rightXAxis == 255 && r->leftXAxis == 128);
+	joysticks[0].simConnect(0x0079, 0x0006, JoystickController::UNKNOWN);
+	run(20000, 100, loop);
+	joysticks[0].simInput(0, 1, low);
+	run(20000, 100, loop);
+	r = last_report();
+	CHECK(r->rightXAxis == 255 && r->leftXAxis == 64);
+	joysticks[0].simDisconnect();
+	joysticks[2].simDisconnect();
+}
+
+static const uint8_t *output_data;
+static uint32_t output_len;
+
+static void output_handler(const uint8_t *data, uint32_t len)
+{
+	output_data = data;
+	output_len = len;
+}
+
+static void test_output_report(void)
+{
+	static const uint8_t report[NSGAMEPAD_OUTPUT_SIZE + 2] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+	start();
+	NSGamepad.setHandleOutputReport(output_handler);
+	sim_host_set_report(report, 4);
+	CHECK(output_data == report && output_len == 4);
+	// longer than the report descriptor allows
+	sim_host_set_report(report, sizeof(report));
+	CHECK(output_len == NSGAMEPAD_OUTPUT_SIZE);
+	NSGamepad.setHandleOutputReport(NULL);
+	output_len = 0;
+	sim_host_set_report(report, 4);
+	CHECK(output_len == 0);
+}
+
+// NSPassthru forwards rumble and LEDs to the attached controller
+static void test_passthru_rumble(void)
+{
+	static const uint8_t report[NSGAMEPAD_OUTPUT_SIZE] = {0x40, 0xC0, 10, 20, 30};
+	sim_reset();
+	sim_usb_configure(0);
+	setup();
+	joysticks[0].simConnect(0x0F0D, 0x00C1, JoystickController::HORIPAD);
+	sim_host_set_report(report, sizeof(report));
+	run(1000, 100, loop);
+	CHECK(joysticks[0].sim_rumble[0] == 0x40 && joysticks[0].sim_rumble[1] == 0xC0);
+	CHECK(joysticks[0].sim_leds[0] == 10 && joysticks[0].sim_leds[1] == 20 && joysticks[0].sim_leds[2] == 30);
+	joysticks[0].simDisconnect();
+	NSGamepad.setHandleOutputReport(NULL);
+}
+
+static void bench(uint32_t frames)
+{
+	static sim_joystick_event_t script[1000];
+	sim_reset();
+	sim_usb_configure(0);
+	setup();
+	joysticks[0].simConnect(0x044F, 0xB10A, JoystickController::T16000M);
+	for (uint32_t i = 0; i < 1000; i++) {
+		sim_joystick_event_t *e = script + i;
+		memset(e, 0, sizeof(*e));
+		e->time_us = i * 1000;
+		e->buttons = (i & 1) ? 0x0005 : 0x0002;
+		e->axis_mask = 0x223;
+		e->axis[0] = (i * 37) & 0x3FFF;
+		e->axis[1] = (i * 91) & 0x3FFF;
+		e->axis[5] = i & 0xFF;
+		e->axis[9] = 15;
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	uint64_t reports = 0;
+	for (uint32_t f = 0; f < frames; f++) {
+		if ((f % 1000) == 0) {
+			reports += sim_report_count();
+			sim_report_clear();
+			for (uint32_t i = 0; i < 1000; i++) {
+				script[i].time_us = sim_time_us() + i * 1000;
+			}
+			sim_joystick_script(joysticks, script, 1000);
+		}
+		// ten passes through the sketch loop per 1 ms frame
+		run(1000, 100, loop);
+	}
+	reports += sim_report_count();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double sec = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	printf("%u frames, %llu reports in %.3f s, %.0f frames/s\n", frames,
+		(unsigned long long)reports, sec, frames / sec);
+	joysticks[0].simDisconnect();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench((argc > 2) ? strtoul(argv[2], NULL, 0) : 100000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "bench-debounce") == 0) {
+		bench_debounce((argc > 2) ? strtoul(argv[2], NULL, 0) : 1000);
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "-v") == 0) sim_verbose(1);
+
+	test_write();
+	test_loop_period();
+	test_interval();
+	test_sof_sync();
+	test_nowait();
+	test_transmit_complete();
+	test_latest_wins();
+	test_commit();
+	test_pulse_stretch();
+	test_passthru_t16k();
+	test_passthru_instance();
+	test_output_report();
+	test_passthru_rumble();
+	test_script();
+	test_map();
+	test_input();
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+/* Builds examples/NSPassthru for the host simulation.
+ *
+ * The Arduino builder adds prototypes for sketch functions, add the ones
+ * NSPassthru.ino needs before their definition.
+ */
+#include "Arduino.h"
+#include <USBHost_t36.h>
+
+void PrintDeviceListChanges();
+void handle_output_report(const uint8_t *data, uint32_t len);
+void forward_output_report();
+void build_report(void *report);
+void update_report();
+void handle_joystick_event(JoystickController &joystick, uint64_t changed_axes,
+	uint32_t pressed, uint32_t released);
+
+#include "../../examples/NSPassthru/NSPassthru.ino"
@@ -0,0 +1,34 @@
+/* Shared helpers for the host simulation tests */
+#ifndef sim_test_h_
+#define sim_test_h_
+
+#include "Arduino.h"
+
+extern int checks;
+extern int failures;
+
+#define CHECK(cond) do { \
+	checks++; \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+// newest report read by the host, or NULL
+const HID_NSGamepadReport_Data_t *last_report(void);
+// configure at full speed, begin NSGamepad and clear the report log
+void start(void);
+// run a sketch style loop, calling fn every step_us
+void run(uint32_t usec, uint32_t step_us, void (*fn)(void));
+
+// test_script.cpp
+void test_script(void);
+// test_map.cpp
+void test_map(void);
+// test_input.cpp
+void test_input(void);
+// press latency of the debouncers on a simulated bouncing button
+void bench_debounce(uint32_t presses);
+
+#endif
@@ -0,0 +1,484 @@
+/* NSGamepadInput analog and digital input tests */
+#include "NSCalibration.h"
+#include "NSPinScan.h"
+#include "NSAnalogScan.h"
+#include "NSAxisFilter.h"
+#include "Bounce2.h"
+#include "sim_test.h"
+
+#define DEFAULT_SHAPE {128, 1024 - 128, 0, 0, 0, 0, 0, 255}
+
+static void calibration_loop(NSCalibration &cal, uint32_t msec)
+{
+	for (uint32_t t = 0; t < msec; t++) {
+		cal.loop();
+		sim_advance_us(1000);
+	}
+}
+
+static void test_calibration(void)
+{
+	start();
+	sim_eeprom_erase();
+	static NSAxisShape shapes[2] = {DEFAULT_SHAPE, DEFAULT_SHAPE};
+	static NSAxisCurve curves[2];
+	static NSCalibration cal;
+	CHECK(!cal.begin(shapes, curves, 2, 0, 64));
+
+	// the first sample is the rest position, sweeps widen the range
+	cal.read(0, 480);
+	cal.read(1, 520);
+	cal.read(0, 40);
+	cal.read(0, 1000);
+	cal.read(1, 10);
+	cal.read(1, 1020);
+	calibration_loop(cal, 10);
+	CHECK(cal.read(0, 40) == 0 && cal.read(0, 1000) == 255);
+	CHECK(cal.read(0, 480) == 128 && cal.read(1, 520) == 128);
+	CHECK(shapes[0].inCenter == 480 && shapes[1].inMin == 10);
+	// saved only once the axes settle
+	CHECK(sim_eeprom_writes() == 0);
+	calibration_loop(cal, NSCAL_SAVE_MS);
+	CHECK(sim_eeprom_writes() > 0);
+	uint32_t writes = sim_eeprom_writes();
+	calibration_loop(cal, NSCAL_SAVE_MS);
+	CHECK(sim_eeprom_writes() == writes);
+
+	// power cycle: calibrated from the first sample
+	static NSAxisShape fresh[2] = {DEFAULT_SHAPE, DEFAULT_SHAPE};
+	static NSCalibration cal2;
+	CHECK(cal2.begin(fresh, curves, 2, 0, 64));
+	CHECK(cal2.read(0, 1000) == 255 && cal2.read(1, 10) == 0);
+	CHECK(cal2.read(0, 480) == 128);
+	CHECK(fresh[0].inMin == 40 && fresh[1].inMax == 1020);
+
+	// the center follows a stick resting off it
+	for (int i = 0; i < 2000; i++) cal2.read(0, 490);
+	calibration_loop(cal2, 2);
+	CHECK(fresh[0].inCenter >= 486 && fresh[0].inCenter <= 490);
+	CHECK(cal2.read(0, 490) == 128);
+
+	// saves go round the 4 slots of 15 bytes, the newest is loaded
+	for (int i = 0; i < 10; i++) {
+		cal2.read(0, 1001 + i);
+		cal2.save();
+	}
+	static NSAxisShape again[2] = {DEFAULT_SHAPE, DEFAULT_SHAPE};
+	CHECK(cal.begin(again, curves, 2, 0, 64));
+	CHECK(again[0].inMax == 1010);
+	// a save cut short by a power loss falls back to the one before.  After
+	// the first save in slot 0, the tenth of these went to slot 2.
+	eeprom_write_byte((uint8_t *)(uintptr_t)(2 * 15 + 5), 0x12);
+	CHECK(cal.begin(again, curves, 2, 0, 64));
+	CHECK(again[0].inMax == 1009);
+	// a different axis count is not a calibration for these axes
+	CHECK(!cal.begin(again, curves, 1, 0, 64));
+
+	// a sweep rebuilds the curve once per NSCAL_REBUILD_MS at most
+	cal.read(0, 512);
+	cal.read(0, 1020);
+	calibration_loop(cal, 1);
+	CHECK(cal.read(0, 1009) < 255);
+	cal.read(0, 1030);
+	calibration_loop(cal, 10);
+	CHECK(cal.read(0, 1020) == 255);
+	calibration_loop(cal, NSCAL_REBUILD_MS);
+	CHECK(cal.read(0, 1020) < 255);
+
+	// the sketch can choose when to save
+	writes = sim_eeprom_writes();
+	cal.autoSave(false);
+	calibration_loop(cal, NSCAL_SAVE_MS);
+	CHECK(sim_eeprom_writes() == writes && cal.saveDue());
+	cal.save();
+	CHECK(sim_eeprom_writes() > writes && !cal.saveDue());
+	cal.autoSave(true);
+}
+
+static void test_analog_scan(void)
+{
+	start();
+	static const uint8_t axes[] = {2, 15};
+	static NSAnalogScan analog;
+	sim_analog_input(2, 100);
+	sim_analog_input(1, 700);
+	CHECK(analog.begin(axes, 2, 4));
+	CHECK(analog.read(0) == 100 && analog.read(1) == 700 && analog.rounds() == 0);
+
+	// a value is published after 4 rounds of both pins
+	sim_analog_input(2, 200);
+	for (int i = 0; i < 7; i++) analog.update();
+	CHECK(analog.read(0) == 100 && analog.rounds() == 0);
+	analog.update();
+	CHECK(analog.read(0) == 200 && analog.read(1) == 700 && analog.rounds() == 1);
+
+	// the rounds are averaged and rounded
+	static const int noisy[3][4] = {{300, 301, 301, 301}, {300, 300, 301, 301}, {300, 300, 300, 301}};
+	static const uint16_t expect[3] = {301, 301, 300};
+	for (int n = 0; n < 3; n++) {
+		for (int r = 0; r < 4; r++) {
+			sim_analog_input(2, noisy[n][r]);
+			analog.update();
+			analog.update();
+		}
+		CHECK(analog.read(0) == expect[n]);
+	}
+	CHECK(analog.rounds() == 4);
+
+	analog.end();
+	for (int i = 0; i < 8; i++) analog.update();
+	CHECK(analog.rounds() == 4);
+
+	static const uint8_t bad[] = {2, 12};
+	CHECK(!analog.begin(bad, 2));
+	static const uint8_t many[NSANALOG_PINS + 1] = {0};
+	CHECK(!analog.begin(many, NSANALOG_PINS + 1));
+	CHECK(!analog.begin(many, 0));
+}
+
+static void test_axis_filter(void)
+{
+	// 1 Hz at rest, 0.1 Hz more per count per second, 200 calls a second
+	static const NSFilterShape shape = {200, 100, 100, 100};
+	NSAxisFilter filter;
+	filter.begin(shape);
+	CHECK(filter.apply(128) == 128);
+	bool steady = true;
+	for (int i = 0; i < 100; i++) steady = steady && filter.apply(128) == 128;
+	CHECK(steady);
+
+	// jitter of a count at rest does not reach the output
+	int changes = 0;
+	uint16_t last = 128;
+	for (int i = 0; i < 400; i++) {
+		uint16_t y = filter.apply(128 + (i & 1));
+		if (y != last) changes++;
+		last = y;
+	}
+	CHECK(changes <= 1 && (last == 128 || last == 129));
+
+	// a fast move is followed within a few calls
+	filter.reset();
+	filter.apply(128);
+	uint16_t y = 0;
+	for (int i = 0; i < 3; i++) y = filter.apply(255);
+	CHECK(y >= 245);
+	for (int i = 0; i < 400; i++) y = filter.apply(255);
+	CHECK(y == 255);
+
+	// without beta it is a plain 1 Hz low pass
+	static const NSFilterShape fixed = {200, 100, 0, 0};
+	filter.begin(fixed);
+	filter.apply(0);
+	CHECK(filter.apply(1000) < 50);
+	for (int i = 0; i < 2000; i++) y = filter.apply(1000);
+	CHECK(y == 1000);
+}
+
+static NSPinScan *scan_under_test;
+static uint32_t scan_changes;
+
+static void scan_loop(void)
+{
+	if (scan_under_test->update()) scan_changes++;
+}
+
+static void test_pin_scan(void)
+{
+	start();
+	static const uint8_t buttons[] = {2, 3, 40};
+	static const uint8_t high[] = {33};
+	static NSPinScan pins;
+	scan_under_test = &pins;
+	CHECK(pins.attach(buttons, 3) == 0);
+	sim_digital_input(33, LOW);
+	CHECK(pins.attach(high, 1, INPUT_PULLDOWN) == 3);
+	pins.interval(10);
+	CHECK(pins.read() == 0);
+	sim_digital_input(40, LOW);
+	sim_digital_input(33, HIGH);
+	CHECK(pins.scan() == 0xC);
+	CHECK(pins.read() == 0);
+
+	// changes once the pins have held their level for the interval
+	scan_changes = 0;
+	run(7000, 100, scan_loop);
+	CHECK(pins.read() == 0 && scan_changes == 0);
+	run(3100, 100, scan_loop);
+	CHECK(pins.read() == 0xC && scan_changes == 1);
+
+	// bounces shorter than the interval are ignored
+	for (int i = 0; i < 10; i++) {
+		sim_digital_input(2, i & 1);
+		run(4000, 100, scan_loop);
+	}
+	CHECK(pins.read() == 0xC && scan_changes == 1);
+	sim_digital_input(2, LOW);
+	run(10100, 100, scan_loop);
+	CHECK(pins.read() == 0xD && scan_changes == 2);
+	sim_digital_input(40, HIGH);
+	sim_digital_input(2, HIGH);
+	bool seen = false;
+	for (int i = 0; i < 200; i++) {
+		if (pins.update()) {
+			CHECK(pins.released() == 0x5 && pins.pressed() == 0);
+			seen = true;
+		}
+		sim_advance_us(100);
+	}
+	CHECK(seen && pins.read() == 0x8);
+}
+
+static void test_pin_eager(void)
+{
+	start();
+	static const uint8_t buttons[] = {2, 3};
+	static NSPinScan pins;
+	scan_under_test = &pins;
+	pins.attach(buttons, 2);
+	pins.interval(10);
+	pins.eager(0x1, 5);
+
+	// the first edge is taken on the next update, between scans too
+	sim_advance_us(1000);
+	sim_digital_input(2, LOW);
+	sim_digital_input(3, LOW);
+	CHECK(pins.update() && pins.pressed() == 0x1);
+	sim_advance_us(100);
+	CHECK(!pins.update());
+
+	// bounces and a release inside the lockout are ignored until it ends
+	scan_changes = 0;
+	sim_digital_input(2, HIGH);
+	run(300, 100, scan_loop);
+	sim_digital_input(2, LOW);
+	run(700, 100, scan_loop);
+	CHECK(pins.read() == 0x1 && scan_changes == 0);
+	sim_digital_input(2, HIGH);
+	run(3700, 100, scan_loop);
+	CHECK(pins.read() == 0x1 && scan_changes == 0);
+	run(300, 100, scan_loop);
+	CHECK(pins.read() == 0 && scan_changes == 1);
+
+	// the other pin still waits for the interval
+	run(6000, 100, scan_loop);
+	CHECK(pins.read() == 0x2 && scan_changes == 2);
+
+	// back to the interval
+	pins.eager(0x1, 0);
+	sim_digital_input(2, LOW);
+	run(5000, 100, scan_loop);
+	CHECK(pins.read() == 0x2);
+	run(6000, 100, scan_loop);
+	CHECK(pins.read() == 0x3);
+}
+
+static NSPinScan irq_pins;
+
+// Takes the pin changes into each report just before it is read, like the
+// examples do
+static void update_report(void)
+{
+	if (NSGamepad.inUpdate()) return;
+	NSGamepad.beginUpdate();
+	if (irq_pins.update()) {
+		NSGamepad.applyChanges(irq_pins.pressed(), irq_pins.released(), NULL, 0);
+	}
+	NSGamepad.commit();
+}
+
+// first report time at or after from with the buttons, or 0
+static uint64_t report_time(uint64_t from, uint16_t buttons)
+{
+	for (uint32_t i = 0; i < sim_report_count(); i++) {
+		const sim_report_t *r = sim_report(i);
+		if (r->time_us >= from && ((const HID_NSGamepadReport_Data_t *)r->data)->buttons == buttons) {
+			return r->time_us;
+		}
+	}
+	return 0;
+}
+
+static void test_pin_interrupts(void)
+{
+	start();
+	static const uint8_t buttons[] = {2, 3, 40};
+	irq_pins.attach(buttons, 3);
+	irq_pins.interval(5);
+	irq_pins.useInterrupts(true);
+	NSGamepad.useSOFSync(true);
+	NSGamepad.setHandleReportUpdate(update_report);
+
+	// no loop() runs at all, the report update takes the edges.  It runs
+	// one 1 ms frame before the host polls.
+	uint64_t pressed = sim_time_us() + 300;
+	sim_advance_us(300);
+	sim_digital_input(3, LOW);
+	sim_advance_us(20000);
+	uint64_t t = report_time(pressed, 0x2);
+	CHECK(t >= pressed + 5000 && t <= pressed + 5000 + NSGamepad.interval() + 1000);
+
+	// bounces restart the interval from the last edge
+	uint64_t bounce = sim_time_us();
+	for (int i = 0; i < 5; i++) {
+		sim_digital_input(40, i & 1 ? HIGH : LOW);
+		sim_advance_us(1000);
+	}
+	sim_advance_us(20000);
+	t = report_time(bounce, 0x6);
+	CHECK(t >= bounce + 4000 + 5000 && t <= bounce + 9000 + NSGamepad.interval() + 1000);
+	CHECK(irq_pins.droppedCount() == 0);
+
+	// more edges than the ring holds between two reports
+	NSGamepad.setHandleReportUpdate(NULL);
+	for (int i = 0; i < NSSCAN_EVENTS * 2 + 1; i++) sim_digital_input(2, i & 1 ? HIGH : LOW);
+	CHECK(irq_pins.droppedCount() > 0);
+	NSGamepad.setHandleReportUpdate(update_report);
+	sim_advance_us(20000);
+	CHECK(last_report()->buttons == 0x7);
+
+	// an eager pin reaches the next report, its bounces are ignored
+	irq_pins.eager(0x2, 5);
+	uint64_t released = sim_time_us();
+	sim_digital_input(3, HIGH);
+	sim_advance_us(200);
+	sim_digital_input(3, LOW);
+	sim_advance_us(200);
+	sim_digital_input(3, HIGH);
+	sim_advance_us(20000);
+	t = report_time(released, 0x5);
+	CHECK(t >= released && t <= released + NSGamepad.interval() + 1000);
+	CHECK(report_time(released, 0x7) == 0 || report_time(released, 0x7) < t);
+	CHECK(last_report()->buttons == 0x5);
+
+	// nothing is taken while loop() is between beginUpdate() and commit()
+	NSGamepad.beginUpdate();
+	sim_digital_input(3, LOW);
+	sim_advance_us(20000);
+	CHECK(last_report()->buttons == 0x5);
+	NSGamepad.commit();
+	sim_advance_us(20000);
+	CHECK(last_report()->buttons == 0x7);
+
+	NSGamepad.setHandleReportUpdate(NULL);
+	NSGamepad.useSOFSync(false);
+	irq_pins.useInterrupts(false);
+}
+
+void test_input(void)
+{
+	test_calibration();
+	test_analog_scan();
+	test_axis_filter();
+	test_pin_scan();
+	test_pin_eager();
+	test_pin_interrupts();
+}
+
+// Press and release latency of one debouncer, from the first edge of the
+// contact to the change being reported
+struct debounce_stats {
+	const char *name;
+	uint64_t press_total, press_worst, release_total;
+	uint32_t presses, releases, extra;
+	bool seen;
+};
+
+static Bounce bench_bounce;
+static NSPinScan bench_scan, bench_eager;
+static debounce_stats bench_stats[3] = {
+	{"Bounce2, 10 ms interval"},
+	{"NSPinScan, 10 ms interval"},
+	{"NSPinScan eager, 10 ms lockout"},
+};
+static uint64_t edge_start, next_poll;
+static bool contact_down;
+static uint32_t bench_seed = 1;
+
+static uint32_t bench_random(uint32_t n)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return (bench_seed >> 16) % n;
+}
+
+static void bench_change(debounce_stats *s, bool pressed, bool released)
+{
+	uint64_t latency = sim_time_us() - edge_start;
+	if (pressed && contact_down && !s->seen) {
+		s->seen = true;
+		s->presses++;
+		s->press_total += latency;
+		if (latency > s->press_worst) s->press_worst = latency;
+	} else if (released && !contact_down && s->seen) {
+		s->seen = false;
+		s->releases++;
+		s->release_total += latency;
+	} else if (pressed || released) {
+		s->extra++;
+	}
+}
+
+// the sketch loop, every 100 us
+static void bench_poll(void)
+{
+	bench_bounce.update();
+	bench_change(&bench_stats[0], bench_bounce.fell(), bench_bounce.rose());
+	bench_scan.update();
+	bench_change(&bench_stats[1], bench_scan.pressed(), bench_scan.released());
+	bench_eager.update();
+	bench_change(&bench_stats[2], bench_eager.pressed(), bench_eager.released());
+}
+
+static void bench_wait(uint32_t usec)
+{
+	uint64_t end = sim_time_us() + usec;
+	while (next_poll <= end) {
+		sim_advance_us(next_poll - sim_time_us());
+		bench_poll();
+		next_poll += 100;
+	}
+	sim_advance_us(end - sim_time_us());
+}
+
+// closes or opens the contact with up to 5 bounces of 50 to 750 us each
+static void bench_contact(bool down)
+{
+	edge_start = sim_time_us();
+	contact_down = down;
+	sim_digital_input(4, down ? LOW : HIGH);
+	for (uint32_t n = bench_random(6); n > 0; n--) {
+		bench_wait(50 + bench_random(700));
+		sim_digital_input(4, down ? HIGH : LOW);
+		bench_wait(50 + bench_random(700));
+		sim_digital_input(4, down ? LOW : HIGH);
+	}
+}
+
+void bench_debounce(uint32_t presses)
+{
+	static const uint8_t pin[] = {4};
+	start();
+	bench_bounce.attach(4, INPUT_PULLUP);
+	bench_bounce.interval(10);
+	bench_scan.attach(pin, 1);
+	bench_scan.interval(10);
+	bench_eager.attach(pin, 1);
+	bench_eager.interval(10);
+	bench_eager.eager(0x1, 10);
+	next_poll = sim_time_us();
+
+	for (uint32_t i = 0; i < presses; i++) {
+		bench_contact(true);
+		bench_wait(30000 + bench_random(60000));
+		bench_contact(false);
+		bench_wait(30000 + bench_random(60000));
+	}
+	printf("%u bouncing presses, loop() every 100 us\n", presses);
+	for (int i = 0; i < 3; i++) {
+		const debounce_stats *s = &bench_stats[i];
+		printf("%-32s press %5.2f ms mean %5.2f ms worst, release %5.2f ms mean, %u missed, %u extra\n",
+			s->name, s->presses ? s->press_total / 1000.0 / s->presses : 0.0,
+			s->press_worst / 1000.0, s->releases ? s->release_total / 1000.0 / s->releases : 0.0,
+			presses - s->presses, s->extra);
+	}
+}
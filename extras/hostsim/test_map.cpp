@@ -0,0 +1,594 @@
+/* NSGamepadMap controller mapping tests */
+#include "NSGamepadMap.h"
+#include "sim_test.h"
+
+static USBHost host;
+static JoystickController joy(host);
+static NSGamepadMap jmap;
+
+static const uint8_t BUTTONS[] = {
+	NSButton_A, NSButton_B, NSMAP_UNUSED, NSButton_A,
+	NSMAP_DPAD_UP, NSMAP_DPAD_RIGHT, NSMAP_DPAD_DOWN, NSMAP_DPAD_LEFT
+};
+static const NSMapAxis AXES[] = {
+	{0, NSMAP_LEFT_X, 0x3FF},
+	{1, NSMAP_LEFT_Y, 0x3FFF},
+	{5, NSMAP_RIGHT_X, 255},
+};
+// inverted with a deadzone around 100
+static const NSAxisShape SHAPE = {0, 1000, 100, 10, 0, 0, 255, 0};
+static const NSMapAxis SECOND_AXES[] = {
+	{0, NSMAP_RIGHT_Y, 255},
+	{1, NSMAP_RIGHT_X, 0, &SHAPE},
+};
+static const NSStickShape ROUND = {20, 90, false};
+static const NSMapProfile PROFILES[] = {
+	{0x1234, 0x0001, BUTTONS, sizeof(BUTTONS), AXES, 3, 9, NSMAP_RIGHT_STICK},
+	{0x1234, 0x0002, NULL, 14, AXES, 3, 9, NSMAP_DPAD},
+	{0x1234, 0x0002, NULL, 14, SECOND_AXES, 2, NSMAP_UNUSED, 0},
+	{0x1234, 0x0003, NULL, 14, AXES, 3, NSMAP_UNUSED, 0, &ROUND},
+};
+
+static void gamepad_loop(void)
+{
+	NSGamepad.loop();
+}
+
+// one input report of a controller, all axes in mask
+static void input_to(JoystickController &j, NSGamepadMap &m, uint32_t buttons,
+	uint64_t mask, int x, int y, int twist, int hat)
+{
+	int values[JoystickController::STANDARD_AXIS_COUNT] = {x, y, 0, 0, 0, twist, 0, 0, 0, hat};
+	j.simInput(buttons, mask, values);
+	NSGamepad.beginUpdate();
+	m.update(j);
+	NSGamepad.commit();
+	j.joystickDataClear();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+}
+
+static void input(uint32_t buttons, uint64_t mask, int x, int y, int twist, int hat)
+{
+	input_to(joy, jmap, buttons, mask, x, y, twist, hat);
+}
+
+static void test_map_profiles(void)
+{
+	start();
+	CHECK(!jmap.begin(PROFILES, 3, 0x1234, 0x0003));
+	CHECK(!jmap.begin(PROFILES, 4, 0x1234, 0x0004));
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0002, 1));
+	// a third instance reuses the last profile
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0002, 2));
+	joy.simConnect(0x1234, 0x0002, JoystickController::UNKNOWN);
+	input(0, 0x003, 10, 150, 0, 0);
+	CHECK(last_report()->rightYAxis == 10 && last_report()->leftXAxis == 0x80);
+	CHECK(last_report()->rightXAxis == 0x80);
+	input(0, 0x003, 10, 1000, 0, 0);
+	CHECK(last_report()->rightXAxis == 0);
+	joy.simDisconnect();
+}
+
+static void test_map_axes(void)
+{
+	start();
+	joy.simConnect(0x1234, 0x0001, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0001));
+	// axes at 0 are taken on the first report too
+	input(0, 0x223, 0x3FF, 0, 128, 15);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->leftXAxis == 255 && r->leftYAxis == 0);
+	CHECK(r->rightXAxis == 128 && r->rightYAxis == 128);
+	// only the changed axis is written, others keep their values
+	NSGamepad.leftYAxis(77);
+	input(0, 0x223, 0x200, 0, 128, 15);
+	r = last_report();
+	CHECK(r->leftXAxis == (0x200 * 255 + 0x3FF / 2) / 0x3FF && r->leftYAxis == 77);
+	input(0, 0x223, 0x200, 0x3FFF, 128, 15);
+	CHECK(last_report()->leftYAxis == 255);
+	// out of range values are clamped
+	input(0, 0x223, 0x7FF, 0x3FFF, 128, 15);
+	CHECK(last_report()->leftXAxis == 255);
+
+	// the hat moves the right stick while the twist is centered
+	input(0, 0x223, 0x200, 0x3FFF, 128, 3);
+	r = last_report();
+	CHECK(r->rightXAxis == 255 && r->rightYAxis == 255);
+	input(0, 0x223, 0x200, 0x3FFF, 20, 3);
+	CHECK(last_report()->rightXAxis == 20);
+	input(0, 0x223, 0x200, 0x3FFF, 20, 6);
+	r = last_report();
+	CHECK(r->rightXAxis == 20 && r->rightYAxis == 128);
+	// the twist centering alone shows the hat held under it again
+	input(0, 0x020, 0x200, 0x3FFF, 128, 6);
+	r = last_report();
+	CHECK(r->rightXAxis == 0 && r->rightYAxis == 128);
+	joy.simDisconnect();
+}
+
+static void test_map_buttons(void)
+{
+	start();
+	joy.simConnect(0x1234, 0x0001, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0001));
+	input(0x0001, 0, 0, 0, 0, 0);
+	CHECK(last_report()->buttons == (1 << NSButton_A));
+	// two controller buttons on one NS button, unused buttons ignored
+	input(0x000D, 0, 0, 0, 0, 0);
+	CHECK(last_report()->buttons == (1 << NSButton_A));
+	input(0x000C, 0, 0, 0, 0, 0);
+	CHECK(last_report()->buttons == (1 << NSButton_A));
+	// buttons pressed elsewhere are left alone
+	NSGamepad.press(NSButton_Home);
+	input(0x0002, 0, 0, 0, 0, 0);
+	CHECK(last_report()->buttons == ((1 << NSButton_B) | (1 << NSButton_Home)));
+	// dPad buttons
+	input(0x0030, 0, 0, 0, 0, 0);
+	CHECK(last_report()->buttons == (1 << NSButton_Home));
+	CHECK(last_report()->dPad == NSGAMEPAD_DPAD_UP_RIGHT);
+	input(0x0040, 0, 0, 0, 0, 0);
+	CHECK(last_report()->dPad == NSGAMEPAD_DPAD_DOWN);
+	input(0, 0, 0, 0, 0, 0);
+	CHECK(last_report()->dPad == NSGAMEPAD_DPAD_CENTERED);
+	joy.simDisconnect();
+}
+
+// two identical controllers keep their own state, and one going away
+// releases only what it held
+static void test_map_pair(void)
+{
+	static JoystickController joy2(host);
+	static NSGamepadMap jmap2;
+	start();
+	joy.simConnect(0x1234, 0x0002, JoystickController::UNKNOWN);
+	joy2.simConnect(0x1234, 0x0002, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0002, 0));
+	CHECK(jmap2.begin(PROFILES, 3, 0x1234, 0x0002, 1));
+	input_to(joy, jmap, 1 << NSButton_A, 0x001, 0x3FF, 0, 0, 15);
+	input_to(joy2, jmap2, 1 << NSButton_B, 0x001, 255, 0, 0, 15);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->buttons == ((1 << NSButton_A) | (1 << NSButton_B)));
+	CHECK(r->leftXAxis == 255 && r->rightYAxis == 255);
+
+	// each one sees only its own edges
+	input_to(joy, jmap, 1 << NSButton_A, 0, 0x3FF, 0, 0, 15);
+	CHECK(last_report()->buttons == ((1 << NSButton_A) | (1 << NSButton_B)));
+	input_to(joy, jmap, 0, 0, 0x3FF, 0, 0, 15);
+	CHECK(last_report()->buttons == (1 << NSButton_B));
+
+	// the second one disconnects holding B and the right stick down
+	jmap2.end();
+	CHECK(!jmap2);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	r = last_report();
+	CHECK(r->buttons == 0 && r->rightYAxis == 0x80 && r->leftXAxis == 255);
+	// ending again does not touch what others set since
+	NSGamepad.press(NSButton_B);
+	jmap2.end();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(last_report()->buttons == (1 << NSButton_B));
+	joy2.simDisconnect();
+	joy.simDisconnect();
+}
+
+static int event_count;
+static uint64_t event_axes;
+static uint32_t event_pressed, event_released;
+
+static void joystick_event(JoystickController &joystick, uint64_t changed_axes,
+	uint32_t pressed, uint32_t released)
+{
+	event_count++;
+	event_axes |= changed_axes;
+	event_pressed |= pressed;
+	event_released |= released;
+	jmap.update(joystick, changed_axes);
+}
+
+// attachEvent() hands each change to the callback, which maps it without
+// polling available()
+static void test_map_event(void)
+{
+	int values[JoystickController::STANDARD_AXIS_COUNT] = {0x3FE, 0, 0, 0, 0, 200};
+	start();
+	event_count = 0;
+	joy.simConnect(0x1234, 0x0001, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0001));
+	joy.attachEvent(joystick_event);
+	NSGamepad.beginUpdate();
+	joy.simInput(0x0003, 0x021, values);
+	NSGamepad.commit();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(event_count == 1 && !joy.available() && joy.axisChangedMask() == 0);
+	CHECK(event_axes == 0x021 && event_pressed == 0x0003 && event_released == 0);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->buttons == (1 << NSButton_B | 1 << NSButton_A));
+	CHECK(r->leftXAxis == 255 && r->rightXAxis == 200);
+
+	// a report that changes nothing is not an event, the next one only
+	// carries its own changes
+	joy.simInput(0x0003, 0x021, values);
+	CHECK(event_count == 1);
+	event_axes = event_pressed = 0;
+	values[5] = 20;
+	NSGamepad.beginUpdate();
+	joy.simInput(0x0002, 0x021, values);
+	NSGamepad.commit();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(event_count == 2 && event_axes == 0x020);
+	CHECK(event_pressed == 0 && event_released == 0x0001);
+	r = last_report();
+	CHECK(r->buttons == (1 << NSButton_B) && r->rightXAxis == 20);
+	joy.attachEvent(NULL);
+	joy.simDisconnect();
+}
+
+// attachQueue() keeps every change in order, updateEvents() maps them all
+static void test_map_queue(void)
+{
+	static JoystickController::event_t events[8];
+	JoystickController::event_t e = {0, 0, 0};
+	int values[JoystickController::STANDARD_AXIS_COUNT] = {0x200, 0, 0, 0, 0, 100};
+	start();
+	joy.simConnect(0x1234, 0x0001, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0001));
+	joy.attachQueue(events, 10);
+	joy.simInput(0x0001, 0x021, values);
+	CHECK(!joy.available());
+	jmap.updateEvents(joy);
+	CHECK(!joy.readEvent(e));
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	CHECK(last_report()->buttons == (1 << NSButton_A) && last_report()->rightXAxis == 100);
+
+	// a tap and a twist between two reads are all recorded
+	joy.simInput(0x0003, 0x021, values);
+	sim_advance_us(1000);
+	values[5] = 30;
+	joy.simInput(0x0001, 0x021, values);
+	CHECK(joy.readEvent(e) && e.axis == JoystickController::EVENT_BUTTONS && e.value == 0x0003);
+	uint32_t first = e.time;
+	CHECK(joy.readEvent(e) && e.axis == JoystickController::EVENT_BUTTONS && e.value == 0x0001);
+	CHECK(e.time - first >= 1000);
+	CHECK(joy.readEvent(e) && e.axis == 5 && e.value == 30);
+	CHECK(!joy.readEvent(e));
+
+	// the map takes them in order and ends at the latest values
+	values[0] = 0;
+	values[5] = 60;
+	joy.simInput(0x0003, 0x021, values);
+	joy.simInput(0x0001, 0x021, values);
+	jmap.updateEvents(joy);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->buttons == (1 << NSButton_A) && r->leftXAxis == 0 && r->rightXAxis == 60);
+
+	// with pulse stretching the host sees a tap read in one pass
+	NSGamepad.usePulseStretch(true);
+	uint32_t index = sim_report_count();
+	joy.simInput(0x0003, 0x021, values);
+	joy.simInput(0x0001, 0x021, values);
+	jmap.updateEvents(joy);
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	int taps = 0;
+	for (uint32_t i = index; i < sim_report_count(); i++) {
+		r = (const HID_NSGamepadReport_Data_t *)sim_report(i)->data;
+		if (r->buttons & (1 << NSButton_B)) taps++;
+	}
+	CHECK(taps == 1 && last_report()->buttons == (1 << NSButton_A));
+	NSGamepad.usePulseStretch(false);
+
+	// a full queue drops changes, the map then starts over from the latest
+	for (int i = 0; i < 10; i++) {
+		joy.simInput((i & 1) ? 0x0001 : 0x0003, 0x001, values);
+	}
+	values[0] = 0x3FF;
+	joy.simInput(0x0000, 0x001, values);
+	CHECK(joy.droppedEvents() > 0);
+	jmap.updateEvents(joy);
+	CHECK(!joy.readEvent(e));
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+	r = last_report();
+	CHECK(r->buttons == 0 && r->leftXAxis == 255 && r->rightXAxis == 60);
+	joy.attachQueue(NULL, 0);
+	joy.simDisconnect();
+}
+
+static NSGamepadMerge merge;
+
+static void merge_update(void)
+{
+	merge.update();
+	run(4 * NSGamepad.interval(), 100, gamepad_loop);
+}
+
+// a controller and a second source through a merge
+static void test_merge(void)
+{
+	uint8_t report[NSGAMEPAD_REPORT_SIZE];
+	start();
+	merge.begin(2);
+	joy.simConnect(0x1234, 0x0001, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 3, 0x1234, 0x0001));
+	jmap.mergeInto(&merge, 0);
+
+	// a release from one source does not cancel a hold on the other
+	input(0x0001, 0x001, 0x300, 0, 0, 15);
+	merge_update();
+	CHECK(last_report()->buttons == (1 << NSButton_A));
+	merge.applyChanges(1, 1 << NSButton_A, 0, NULL, 0);
+	merge_update();
+	merge.applyChanges(1, 0, 1 << NSButton_A, NULL, 0);
+	merge_update();
+	CHECK(last_report()->buttons == (1 << NSButton_A));
+	// buttons the merge does not hold are left alone
+	NSGamepad.press(NSButton_Home);
+	merge.applyChanges(1, 1 << NSButton_B, 0, NULL, 0);
+	merge_update();
+	CHECK(last_report()->buttons == ((1 << NSButton_A) | (1 << NSButton_B) | (1 << NSButton_Home)));
+
+	// the axis furthest off center wins, or the first source with priority
+	CHECK(last_report()->leftXAxis == merge.value(NSMERGE_LEFT_X));
+	uint8_t x = merge.value(NSMERGE_LEFT_X);
+	CHECK(x == (0x300 * 255 + 0x3FF / 2) / 0x3FF);
+	report[NSMERGE_LEFT_X] = 10;
+	merge.applyChanges(1, 0, 0, report, 1 << NSMERGE_LEFT_X);
+	merge_update();
+	CHECK(last_report()->leftXAxis == 10);
+	merge.policy(NSMERGE_LEFT_X, NSMERGE_PRIORITY);
+	merge.applyChanges(1, 0, 0, report, 1 << NSMERGE_LEFT_X);
+	merge_update();
+	CHECK(last_report()->leftXAxis == x);
+
+	// dPads add up, opposite directions cancel
+	input(0x0011, 0, 0x300, 0, 0, 15);
+	report[NSMERGE_DPAD] = NSGAMEPAD_DPAD_RIGHT;
+	merge.applyChanges(1, 0, 0, report, 1 << NSMERGE_DPAD);
+	merge_update();
+	CHECK(last_report()->dPad == NSGAMEPAD_DPAD_UP_RIGHT);
+	report[NSMERGE_DPAD] = NSGAMEPAD_DPAD_DOWN;
+	merge.applyChanges(1, 0, 0, report, 1 << NSMERGE_DPAD);
+	merge_update();
+	CHECK(last_report()->dPad == NSGAMEPAD_DPAD_CENTERED);
+
+	// a button released and pressed again between two updates reaches the
+	// host as a release, unless another source holds it too
+	NSGamepad.usePulseStretch(true);
+	merge.applyChanges(1, (1 << NSButton_X) | (1 << NSButton_A), 0, NULL, 0);
+	merge_update();
+	uint32_t index = sim_report_count();
+	merge.applyChanges(1, 0, (1 << NSButton_X) | (1 << NSButton_A), NULL, 0);
+	merge.applyChanges(1, (1 << NSButton_X) | (1 << NSButton_A), 0, NULL, 0);
+	merge_update();
+	int x_released = 0, a_released = 0;
+	for (uint32_t i = index; i < sim_report_count(); i++) {
+		const HID_NSGamepadReport_Data_t *r = (const HID_NSGamepadReport_Data_t *)sim_report(i)->data;
+		if (!(r->buttons & (1 << NSButton_X))) x_released++;
+		if (!(r->buttons & (1 << NSButton_A))) a_released++;
+	}
+	CHECK(x_released == 1 && a_released == 0);
+	CHECK(last_report()->buttons & (1 << NSButton_X));
+	// and one pressed and released again as a press
+	index = sim_report_count();
+	merge.applyChanges(1, 1 << NSButton_Y, 0, NULL, 0);
+	merge.applyChanges(1, 0, 1 << NSButton_Y, NULL, 0);
+	merge_update();
+	int y_pressed = 0;
+	for (uint32_t i = index; i < sim_report_count(); i++) {
+		const HID_NSGamepadReport_Data_t *r = (const HID_NSGamepadReport_Data_t *)sim_report(i)->data;
+		if (r->buttons & (1 << NSButton_Y)) y_pressed++;
+	}
+	CHECK(y_pressed == 1 && !(last_report()->buttons & (1 << NSButton_Y)));
+	merge.applyChanges(1, 0, (1 << NSButton_X) | (1 << NSButton_A), NULL, 0);
+	merge_update();
+	NSGamepad.usePulseStretch(false);
+
+	// the controller goes away, the other source keeps its hold
+	jmap.end();
+	merge_update();
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->buttons == ((1 << NSButton_B) | (1 << NSButton_Home)));
+	CHECK(r->leftXAxis == 10 && r->dPad == NSGAMEPAD_DPAD_DOWN);
+	jmap.mergeInto(NULL, 0);
+	joy.simDisconnect();
+}
+
+// the tables give the same result as remapping bit by bit
+static void test_button_remap(void)
+{
+	static const uint8_t map[NSREMAP_BUTTONS] = {
+		NSButton_A, NSButton_B, NSMAP_UNUSED, NSButton_A, NSMAP_DPAD_UP,
+		NSMAP_DPAD_RIGHT, NSMAP_DPAD_DOWN, NSMAP_DPAD_LEFT, NSButton_Home,
+		NSButton_Y, NSButton_X, NSButton_Capture, NSButton_Reserved2,
+		NSButton_LeftStick, NSButton_RightStick, NSButton_Minus, NSButton_Plus,
+		NSButton_LeftTrigger, NSButton_RightTrigger, NSButton_LeftThrottle,
+		NSButton_RightThrottle, NSMAP_UNUSED, NSButton_Reserved1
+	};
+	static NSButtonRemap remap;
+	remap.begin(map, sizeof(map));
+	CHECK(remap.hasDPad());
+	uint32_t bad = 0;
+	uint32_t x = 12345;
+	for (int n = 0; n < 100000; n++) {
+		x = x * 1103515245 + 12345;
+		uint32_t in = x ^ (x >> 13);
+		uint32_t expect = 0;
+		for (int i = 0; i < NSREMAP_BUTTONS; i++) {
+			if ((in & (1ul << i)) && map[i] != NSMAP_UNUSED) expect |= 1ul << map[i];
+		}
+		if (remap.remap(in) != expect) bad++;
+	}
+	CHECK(bad == 0);
+	CHECK(NSButtonRemap::dPad(remap.remap(0x30)) == NSGAMEPAD_DPAD_UP_RIGHT);
+	CHECK(NSButtonRemap::dPad(remap.remap(0x50)) == NSGAMEPAD_DPAD_CENTERED);
+	remap.begin(NULL, 14);
+	CHECK(!remap.hasDPad());
+	CHECK(remap.remap(0xFFFFFFFF) == 0x3FFF);
+}
+
+static int curve_error(const NSAxisCurve &c, uint32_t maximum)
+{
+	int worst = 0;
+	for (uint32_t v = 0; v <= maximum; v++) {
+		int e = c.apply(v) - (int)((v * 255 + maximum / 2) / maximum);
+		if (e < 0) e = -e;
+		if (e > worst) worst = e;
+	}
+	return worst;
+}
+
+static void test_axis_curve(void)
+{
+	static NSAxisCurve c;
+	// linear 8 bits is exact, wider inputs are rounded to within 1
+	c.begin(255);
+	uint32_t bad = 0;
+	for (uint32_t v = 0; v < 256; v++) {
+		if (c.apply(v) != v) bad++;
+	}
+	CHECK(bad == 0);
+	c.begin(0x3FF);
+	CHECK(curve_error(c, 0x3FF) <= 1);
+	c.begin(0x3FFF);
+	CHECK(curve_error(c, 0x3FFF) <= 1);
+	CHECK(c.apply(0) == 0 && c.apply(0x3FFF) == 255 && c.apply(0xFFFF) == 255);
+
+	// off center rest position, inverted
+	NSAxisShape shape = {100, 1000, 400, 0, 0, 0, 255, 0};
+	c.begin(shape);
+	CHECK(c.apply(0) == 255 && c.apply(100) == 255);
+	CHECK(c.apply(400) == 128);
+	CHECK(c.apply(1000) == 0);
+	CHECK(c.apply(250) == 191 || c.apply(250) == 192);
+
+	// deadzone, then full range outside it.  The edge is blurred by one
+	// table segment, 4 steps here.
+	shape = (NSAxisShape){0, 1000, 0, 20, 0, 0, 0, 255};
+	c.begin(shape);
+	CHECK(c.apply(405) == 128 && c.apply(595) == 128);
+	CHECK(c.apply(0) == 0 && c.apply(1000) == 255);
+	CHECK(c.apply(800) == 192 || c.apply(800) == 191);
+
+	// cubic response and gain
+	shape = (NSAxisShape){0, 1000, 0, 0, 100, 0, 0, 255};
+	c.begin(shape);
+	CHECK(c.apply(750) == 143);
+	CHECK(c.apply(1000) == 255);
+	shape = (NSAxisShape){0, 1000, 0, 0, 0, 200, 0, 255};
+	c.begin(shape);
+	CHECK(c.apply(750) == 255 && c.apply(250) == 0);
+
+	// custom response points
+	static const uint8_t points[] = {0, 0, 255};
+	shape = (NSAxisShape){0, 1000, 0, 0, 0, 0, 0, 255, points, 3};
+	c.begin(shape);
+	CHECK(c.apply(750) == 128 && c.apply(875) == 191);
+
+	// in_max is the last table entry, and anything past it the same
+	shape = (NSAxisShape){0, 1000, 0, 0, 0, 0, 0, 200};
+	c.begin(shape);
+	CHECK(c.apply(1000) == 200 && c.apply(1001) == 200 && c.apply(0xFFFF) == 200);
+	shape = (NSAxisShape){100, 1000, 400, 0, 0, 0, 255, 0};
+	c.begin(shape);
+	CHECK(c.apply(1000) == 0 && c.apply(0xFFFF) == 0);
+}
+
+static void test_map_stick(void)
+{
+	start();
+	joy.simConnect(0x1234, 0x0003, JoystickController::UNKNOWN);
+	CHECK(jmap.begin(PROFILES, 4, 0x1234, 0x0003));
+	// X alone inside the deadzone, Y moved too far off center is not
+	input(0, 0x003, 0x200 + 80, 0x2000, 0, 0);
+	const HID_NSGamepadReport_Data_t *r = last_report();
+	CHECK(r->leftXAxis == 128 && r->leftYAxis == 128);
+	input(0, 0x003, 0x200 + 80, 0x2000 + 0x500, 0, 0);
+	r = last_report();
+	CHECK(r->leftXAxis > 128 && r->leftYAxis > 128);
+	// only Y changed, X is still shaped with it
+	input(0, 0x002, 0, 0x3FFF, 0, 0);
+	r = last_report();
+	CHECK(r->leftXAxis > 128 && r->leftXAxis < 160 && r->leftYAxis > 240);
+	// the twist has no stick shape
+	input(0, 0x020, 0, 0, 140, 0);
+	CHECK(last_report()->rightXAxis == 140);
+	joy.simDisconnect();
+}
+
+static int stick_radius2(uint8_t x, uint8_t y)
+{
+	return (x - 128) * (x - 128) + (y - 128) * (y - 128);
+}
+
+static void test_stick(void)
+{
+	static NSStick s;
+	// no deadzone, round gate: inside the circle the stick is unchanged
+	NSStickShape shape = {0, 0, false};
+	s.begin(shape);
+	int bad = 0;
+	for (int x = 0; x < 256; x++) {
+		for (int y = 0; y < 256; y++) {
+			uint8_t ox = x, oy = y;
+			s.apply(ox, oy);
+			if (stick_radius2(x, y) <= 127 * 127) {
+				if (abs(ox - x) > 1 || abs(oy - y) > 1) bad++;
+			}
+			// outside it is pulled in to the circle, same direction
+			else if (abs(stick_radius2(ox, oy) - 128 * 128) > 400) bad++;
+		}
+	}
+	CHECK(bad == 0);
+	uint8_t x = 0, y = 128;
+	s.apply(x, y);
+	CHECK(x == 0 && y == 128);
+
+	// the deadzone is a circle, output starts from 0 at its edge
+	shape = (NSStickShape){25, 0, false};
+	s.begin(shape);
+	x = 128 + 22, y = 128 + 22;
+	s.apply(x, y);
+	CHECK(x == 128 && y == 128);
+	x = 128 + 33, y = 128;
+	s.apply(x, y);
+	CHECK(x == 128 || x == 129);
+	x = 128 + 80, y = 128;
+	s.apply(x, y);
+	CHECK(abs(x - (128 + 64)) <= 1 && y == 128);
+	x = 0, y = 128;
+	s.apply(x, y);
+	CHECK(x == 0 && y == 128);
+
+	// square gate: the corners reach the circle, the edges stay full
+	shape = (NSStickShape){0, 0, true};
+	s.begin(shape);
+	x = 255, y = 255;
+	s.apply(x, y);
+	CHECK(abs(x - 218) <= 1 && x == y);
+	x = 255, y = 191;
+	s.apply(x, y);
+	CHECK(abs(stick_radius2(x, y) - 127 * 127) < 300 && x > y);
+	x = 128, y = 255;
+	s.apply(x, y);
+	CHECK(x == 128 && y == 255);
+	// outer edge: 80% of the way reads as full
+	shape = (NSStickShape){0, 80, true};
+	s.begin(shape);
+	x = 128 - 103, y = 128;
+	s.apply(x, y);
+	CHECK(x == 0 && y == 128);
+}
+
+void test_map(void)
+{
+	test_button_remap();
+	test_axis_curve();
+	test_stick();
+	test_map_stick();
+	test_map_profiles();
+	test_map_axes();
+	test_map_buttons();
+	test_map_pair();
+	test_map_event();
+	test_map_queue();
+	test_merge();
+}
@@ -0,0 +1,291 @@
+/* NSGamepadScript playback and recording tests */
+#include "NSGamepadScript.h"
+#include "sim_test.h"
+#include <vector>
+
+static NSScriptPlayer player;
+
+// Builds a script in the documented format
+class ScriptWriter
+{
+public:
+	ScriptWriter(uint32_t tick_usec) : last_tick(0) {
+		const uint8_t header[NSSCRIPT_HEADER_SIZE] = {
+			'N', 'S', 'G', 'S', NSSCRIPT_VERSION, NSSCRIPT_HEADER_SIZE, 0, 0,
+			(uint8_t)tick_usec, (uint8_t)(tick_usec >> 8),
+			(uint8_t)(tick_usec >> 16), (uint8_t)(tick_usec >> 24)
+		};
+		data.assign(header, header + sizeof(header));
+		HID_NSGamepadReport_Data_t neutral = {0, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0};
+		memcpy(state, &neutral, sizeof(state));
+	}
+	void add(uint32_t tick, const HID_NSGamepadReport_Data_t &report) {
+		const uint8_t *bytes = (const uint8_t *)&report;
+		uint32_t delta = tick - last_tick;
+		do {
+			data.push_back((delta & 0x7F) | ((delta > 0x7F) ? 0x80 : 0));
+			delta >>= 7;
+		} while (delta);
+		uint8_t mask = 0;
+		for (int i = 0; i < NSGAMEPAD_REPORT_SIZE; i++) {
+			if (bytes[i] != state[i]) mask |= 1 << i;
+		}
+		data.push_back(mask);
+		for (int i = 0; i < NSGAMEPAD_REPORT_SIZE; i++) {
+			if (mask & (1 << i)) data.push_back(bytes[i]);
+		}
+		memcpy(state, bytes, sizeof(state));
+		last_tick = tick;
+	}
+	std::vector<uint8_t> data;
+private:
+	uint8_t state[NSGAMEPAD_REPORT_SIZE];
+	uint32_t last_tick;
+};
+
+static HID_NSGamepadReport_Data_t frame_report(uint32_t frame)
+{
+	HID_NSGamepadReport_Data_t r = {0, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0};
+	r.buttons = (frame / 3) & 0x3FFF;
+	r.leftXAxis = frame;
+	if (frame % 7 == 0) r.dPad = (frame / 7) & 7;
+	return r;
+}
+
+static void player_loop(void)
+{
+	player.task();
+}
+
+// every report read by the host is the one the script names for that poll
+static void check_frames(uint32_t frames, uint32_t repeat)
+{
+	uint32_t bad = 0;
+	for (uint32_t i = 0; i < frames && i < sim_report_count(); i++) {
+		HID_NSGamepadReport_Data_t expect = frame_report(i / repeat);
+		if (memcmp(sim_report(i)->data, &expect, sizeof(expect)) != 0) bad++;
+	}
+	CHECK(sim_report_count() >= frames);
+	CHECK(bad == 0);
+}
+
+static void test_short_script(void)
+{
+	ScriptWriter w(0);
+	HID_NSGamepadReport_Data_t r = {0, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0};
+	r.buttons = 1 << NSButton_A;
+	w.add(0, r);
+	r.leftXAxis = 10;
+	w.add(3, r);
+	r.buttons = 0;
+	w.add(10, r);
+	w.add(20, r);
+	NSScriptMemory mem(w.data.data(), w.data.size());
+
+	start();
+	CHECK(player.begin(mem));
+	CHECK(player.playing());
+	run(25 * NSGamepad.interval(), 100, player_loop);
+	CHECK(!player.playing());
+	CHECK(!player.error());
+	CHECK(player.frame() == 20);
+	CHECK(usb_nsgamepad_sof_sync_enabled() == 0);
+	const HID_NSGamepadReport_Data_t *d;
+	d = (const HID_NSGamepadReport_Data_t *)sim_report(0)->data;
+	CHECK(d->buttons == (1 << NSButton_A) && d->leftXAxis == 0x80);
+	d = (const HID_NSGamepadReport_Data_t *)sim_report(2)->data;
+	CHECK(d->leftXAxis == 0x80);
+	d = (const HID_NSGamepadReport_Data_t *)sim_report(3)->data;
+	CHECK(d->buttons == (1 << NSButton_A) && d->leftXAxis == 10);
+	d = (const HID_NSGamepadReport_Data_t *)sim_report(9)->data;
+	CHECK(d->buttons == (1 << NSButton_A));
+	d = (const HID_NSGamepadReport_Data_t *)sim_report(10)->data;
+	CHECK(d->buttons == 0 && d->leftXAxis == 10);
+}
+
+// a change every poll, far longer than the decode queue
+static void test_long_script(void)
+{
+	const uint32_t frames = 20000;
+	ScriptWriter w(0);
+	for (uint32_t i = 0; i < frames; i++) w.add(i, frame_report(i));
+	NSScriptMemory mem(w.data.data(), w.data.size());
+
+	start();
+	CHECK(player.begin(mem));
+	run((frames + 5) * NSGamepad.interval(), 250, player_loop);
+	CHECK(!player.playing());
+	CHECK(player.lateCount() == 0);
+	check_frames(frames, 1);
+}
+
+// microsecond ticks are played on the nearest poll at the negotiated rate
+static void test_usec_script(void)
+{
+	start();
+	sim_usb_configure(1);
+	sim_advance_us(10000);
+	sim_report_clear();
+	const uint32_t interval = NSGamepad.interval();
+	ScriptWriter w(1);
+	for (uint32_t i = 0; i < 200; i++) w.add(i * 2 * interval, frame_report(i));
+	NSScriptMemory mem(w.data.data(), w.data.size());
+
+	CHECK(player.begin(mem));
+	run(200 * 2 * interval + 10000, 25, player_loop);
+	CHECK(!player.playing());
+	check_frames(399, 2);
+}
+
+static void test_bad_script(void)
+{
+	static const uint8_t bad[] = {'N', 'S', 'G', 'X', 1, 12, 0, 0, 0, 0, 0, 0};
+	NSScriptMemory mem(bad, sizeof(bad));
+	start();
+	CHECK(!player.begin(mem));
+	CHECK(!player.playing());
+
+	// truncated record
+	ScriptWriter w(0);
+	HID_NSGamepadReport_Data_t r = {0, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0};
+	r.buttons = 0xFF;
+	w.add(5, r);
+	w.data.pop_back();
+	NSScriptMemory cut(w.data.data(), w.data.size());
+	CHECK(player.begin(cut));
+	run(5 * NSGamepad.interval(), 100, player_loop);
+	CHECK(!player.playing());
+	CHECK(player.error());
+}
+
+// collects drained recordings
+class ByteSink : public Print
+{
+public:
+	virtual size_t write(uint8_t b) { return write(&b, 1); }
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		data.insert(data.end(), buffer, buffer + size);
+		return size;
+	}
+	std::vector<uint8_t> data;
+};
+
+static NSScriptRecorder recorder;
+
+static void gamepad_change_loop(void)
+{
+	NSGamepad.leftXAxis(sim_time_us() / NSGamepad.interval());
+	NSGamepad.loop();
+}
+static ByteSink sink;
+
+static void recorder_loop(void)
+{
+	uint32_t frame = NSGamepad.interval() ? sim_time_us() / NSGamepad.interval() : 0;
+	NSGamepad.leftXAxis(frame);
+	NSGamepad.rightYAxis(frame >> 3);
+	NSGamepad.loop();
+	recorder.drain(sink);
+}
+
+// decodes a recording into reports with absolute times
+static std::vector<sim_report_t> decode(const std::vector<uint8_t> &data, uint64_t start_us)
+{
+	std::vector<sim_report_t> out;
+	CHECK(data.size() >= NSSCRIPT_HEADER_SIZE);
+	if (data.size() < NSSCRIPT_HEADER_SIZE) return out;
+	CHECK(memcmp(data.data(), "NSGS", 4) == 0 && data[8] == 1);
+	sim_report_t r;
+	r.time_us = start_us;
+	HID_NSGamepadReport_Data_t neutral = {0, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0};
+	memcpy(r.data, &neutral, sizeof(r.data));
+	size_t i = data[5];
+	while (i < data.size()) {
+		uint32_t delta = 0;
+		for (int shift = 0; ; shift += 7) {
+			uint8_t b = data[i++];
+			delta |= (uint32_t)(b & 0x7F) << shift;
+			if (!(b & 0x80)) break;
+		}
+		uint8_t mask = data[i++];
+		for (int n = 0; n < NSGAMEPAD_REPORT_SIZE; n++) {
+			if (mask & (1 << n)) r.data[n] = data[i++];
+		}
+		r.time_us += delta;
+		out.push_back(r);
+	}
+	CHECK(i == data.size());
+	return out;
+}
+
+// the recording holds every report the host read, at the time it read it
+static void test_record(void)
+{
+	start();
+	sink.data.clear();
+	uint64_t begin_us = sim_time_us();
+	recorder.begin();
+	run(500 * NSGamepad.interval(), 100, recorder_loop);
+	recorder.end();
+	recorder.drain(sink);
+	CHECK(recorder.droppedCount() == 0);
+	CHECK(!recorder.recording());
+	std::vector<sim_report_t> rec = decode(sink.data, begin_us);
+	CHECK(rec.size() == sim_report_count());
+	uint32_t bad = 0;
+	for (uint32_t i = 0; i < rec.size() && i < sim_report_count(); i++) {
+		const sim_report_t *r = sim_report(i);
+		if (r->time_us != rec[i].time_us || memcmp(r->data, rec[i].data, sizeof(r->data))) bad++;
+	}
+	CHECK(bad == 0);
+	// unchanged reports cost a delta and a mask
+	CHECK(sink.data.size() < NSSCRIPT_HEADER_SIZE + rec.size() * 6);
+
+	// played back, the host reads the same reports at the same polls
+	NSScriptMemory mem(sink.data.data(), sink.data.size());
+	start();
+	CHECK(player.begin(mem));
+	run((rec.size() + 5) * NSGamepad.interval(), 100, player_loop);
+	CHECK(!player.playing());
+	CHECK(player.lateCount() == 0);
+	CHECK(sim_report_count() + 1 >= rec.size());
+	// the first poll after begin() plays the records rounded to poll 0
+	uint32_t offset = (rec[0].time_us - begin_us + NSGamepad.interval() / 2) / NSGamepad.interval();
+	bad = 0;
+	for (uint32_t i = 0; i < rec.size(); i++) {
+		const sim_report_t *r = sim_report(i + offset);
+		if (r && memcmp(r->data, rec[i].data, sizeof(r->data))) bad++;
+	}
+	CHECK(bad == 0);
+}
+
+// a full ring drops whole reports and the recording stays decodable
+static void test_record_overflow(void)
+{
+	start();
+	sink.data.clear();
+	uint64_t begin_us = sim_time_us();
+	recorder.begin();
+	run(NSSCRIPT_RECORD_SIZE * NSGamepad.interval(), 100, gamepad_change_loop);
+	recorder.end();
+	CHECK(recorder.droppedCount() > 0);
+	recorder.drain(sink);
+	std::vector<sim_report_t> rec = decode(sink.data, begin_us);
+	CHECK(rec.size() + recorder.droppedCount() == sim_report_count());
+	uint32_t bad = 0;
+	for (uint32_t i = 0; i < rec.size(); i++) {
+		const sim_report_t *r = sim_report(i);
+		if (r->time_us != rec[i].time_us || memcmp(r->data, rec[i].data, sizeof(r->data))) bad++;
+	}
+	CHECK(bad == 0);
+}
+
+void test_script(void)
+{
+	test_short_script();
+	test_long_script();
+	test_usec_script();
+	test_bad_script();
+	test_record();
+	test_record_overflow();
+}
@@ -0,0 +1,181 @@
+#!/usr/bin/python3
+"""Make NS gamepad scripts for the NSGamepadScript library.
+
+The binary format is described in NSGamepadScript.h.  The text format has one
+line per change, the tick followed by the fields that change:
+
+    # tick  field=value ...
+    0       buttons=0x0004
+    6       buttons=0
+    60      lx=255
+    120     lx=128
+    250
+
+Fields are buttons, dpad, lx, ly, rx, ry and filler.  Everything else stays as
+it was, starting from the neutral report.  A line with only a tick marks the
+end of the script.  Ticks are host polls unless a tick_usec=N line or the
+--tick-usec option gives their length in microseconds.
+
+    nsscript.py encode [--tick-usec N] [--c-array NAME] in.txt out.nsg
+    nsscript.py decode in.nsg [out.txt]
+
+decode turns a script or an NSScriptRecorder recording back into text.
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'NSGS'
+VERSION = 1
+HEADER_SIZE = 12
+# report byte of each field, HID_NSGamepadReport_Data_t
+FIELDS = {'dpad': 2, 'lx': 3, 'ly': 4, 'rx': 5, 'ry': 6, 'filler': 7}
+NEUTRAL = bytes([0x00, 0x00, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x00])
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def parse_text(lines, options):
+    """Yields (tick, report) for each line."""
+    report = bytearray(NEUTRAL)
+    for number, line in enumerate(lines, 1):
+        line = line.split('#', 1)[0].split()
+        if not line:
+            continue
+        if line[0].startswith('tick_usec='):
+            if options.tick_usec is None:
+                options.tick_usec = int(line[0].split('=', 1)[1], 0)
+            continue
+        try:
+            tick = int(line[0], 0)
+            for item in line[1:]:
+                name, value = item.split('=', 1)
+                value = int(value, 0)
+                if name == 'buttons':
+                    report[0:2] = struct.pack('<H', value)
+                else:
+                    report[FIELDS[name]] = value
+        except (ValueError, KeyError, struct.error):
+            sys.exit('line %d: cannot parse %r' % (number, ' '.join(line)))
+        yield tick, bytes(report)
+
+
+def encode(events, options):
+    out = bytearray()
+    state = NEUTRAL
+    last_tick = 0
+    for tick, report in events:
+        if tick < last_tick:
+            sys.exit('tick %d is before tick %d' % (tick, last_tick))
+        mask = 0
+        changed = bytearray()
+        for i in range(len(report)):
+            if report[i] != state[i]:
+                mask |= 1 << i
+                changed.append(report[i])
+        out += varint(tick - last_tick) + bytes([mask]) + changed
+        state = report
+        last_tick = tick
+    header = MAGIC + struct.pack('<BBHI', VERSION, HEADER_SIZE, 0, options.tick_usec or 0)
+    return header + bytes(out)
+
+
+def decode(data):
+    """Returns tick_usec and a list of (tick, changes) with changes a list
+    of (field, value)."""
+    if len(data) < HEADER_SIZE or data[0:4] != MAGIC:
+        sys.exit('not an NS gamepad script')
+    version, header_size, _, tick_usec = struct.unpack('<BBHI', data[4:HEADER_SIZE])
+    if version != VERSION:
+        sys.exit('script version %d is not supported' % version)
+    report = bytearray(NEUTRAL)
+    records = []
+    pos = header_size
+    tick = 0
+    try:
+        while pos < len(data):
+            delta = 0
+            shift = 0
+            while True:
+                byte = data[pos]
+                pos += 1
+                delta |= (byte & 0x7F) << shift
+                shift += 7
+                if not byte & 0x80:
+                    break
+            mask = data[pos]
+            pos += 1
+            for i in range(len(report)):
+                if mask & (1 << i):
+                    report[i] = data[pos]
+                    pos += 1
+            tick += delta
+            changes = []
+            if mask & 3:
+                changes.append(('buttons', '0x%04x' % struct.unpack('<H', report[0:2])[0]))
+            for name, index in FIELDS.items():
+                if mask & (1 << index):
+                    changes.append((name, '%d' % report[index]))
+            records.append((tick, changes))
+    except IndexError:
+        sys.stderr.write('script is truncated at byte %d\n' % len(data))
+    return tick_usec, records
+
+
+def c_array(name, data):
+    lines = ['const uint8_t %s[] PROGMEM = {' % name]
+    for i in range(0, len(data), 12):
+        lines.append('    ' + ' '.join('0x%02x,' % b for b in data[i:i + 12]))
+    lines.append('};')
+    return '\n'.join(lines) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+    enc = sub.add_parser('encode', help='text to binary script')
+    enc.add_argument('--tick-usec', type=int,
+                     help='tick length in microseconds, 0 for host polls')
+    enc.add_argument('--c-array', metavar='NAME',
+                     help='write a C array for a script in flash')
+    enc.add_argument('input')
+    enc.add_argument('output')
+    dec = sub.add_parser('decode', help='binary script or recording to text')
+    dec.add_argument('input')
+    dec.add_argument('output', nargs='?')
+    args = parser.parse_args()
+
+    if args.command == 'decode':
+        with open(args.input, 'rb') as f:
+            tick_usec, records = decode(f.read())
+        out = open(args.output, 'w') if args.output else sys.stdout
+        out.write('tick_usec=%d\n' % tick_usec)
+        for tick, changes in records:
+            out.write(' '.join([str(tick)] + ['%s=%s' % c for c in changes]) + '\n')
+        if out is not sys.stdout:
+            out.close()
+        return
+
+    with open(args.input) as f:
+        data = encode(parse_text(f, args), args)
+    if args.c_array:
+        with open(args.output, 'w') as f:
+            f.write(c_array(args.c_array, data))
+    else:
+        with open(args.output, 'wb') as f:
+            f.write(data)
+
+
+if __name__ == '__main__':
+    main()
@@ -300,7 +300,9 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define ENDPOINT3_CONFIG      ENDPOINT_RECEIVE_ONLY
   #define ENDPOINT4_CONFIG      ENDPOINT_TRANSMIT_ONLY
 
-#elif defined(USB_NSGAMEPAD)
+#elif defined(USB_NSGAMEPAD) || defined(USB_NSGAMEPAD_LOWLATENCY)
+  // Full speed polls every 1 ms frame at best, so the low latency type is
+  // the same configuration
   #define DEVICE_CLASS          0x00    // Defined at interface level
   #define DEVICE_SUBCLASS       0x00
   #define DEVICE_PROTOCOL       0x00
@@ -324,6 +326,39 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define NSGAMEPAD_INTERVAL    1
   #define ENDPOINT1_CONFIG      ENDPOINT_TRANSMIT_ONLY
 
+#elif defined(USB_SERIAL_NSGAMEPAD)
+  #define BCD_DEVICE            0x0572  // 5.72
+  #define DEVICE_ATTRIBUTES     0x80    // Bus powered
+  #define DEVICE_POWER          0xFA    // 500 mA
+  #define VENDOR_ID             0x0F0D
+  #define PRODUCT_ID            0x00C1
+  #define MANUFACTURER_NAME     {'H','O','R','I',' ','C','O','.',',','L','T','D','.'}
+  #define MANUFACTURER_NAME_LEN	13
+  #define PRODUCT_NAME          {'H','O','R','I','P','A','D',' ','S'}
+  #define PRODUCT_NAME_LEN      9
+  #define EP0_SIZE              64
+  #define NUM_ENDPOINTS         5
+  #define NUM_USB_BUFFERS       14
+  #define NUM_INTERFACE         3
+  #define CDC_IAD_DESCRIPTOR    1
+  #define CDC_STATUS_INTERFACE  0
+  #define CDC_DATA_INTERFACE    1
+  #define CDC_ACM_ENDPOINT      2
+  #define CDC_RX_ENDPOINT       3
+  #define CDC_TX_ENDPOINT       4
+  #define CDC_ACM_SIZE          16
+  #define CDC_RX_SIZE           64
+  #define CDC_TX_SIZE           64
+  #define NSGAMEPAD_INTERFACE   2
+  #define NSGAMEPAD_ENDPOINT    1
+  #define NSGAMEPAD_SIZE        64
+  #define NSGAMEPAD_REPORT_SIZE 8
+  #define NSGAMEPAD_INTERVAL    1
+  #define ENDPOINT1_CONFIG      ENDPOINT_TRANSMIT_ONLY
+  #define ENDPOINT2_CONFIG      ENDPOINT_TRANSMIT_ONLY
+  #define ENDPOINT3_CONFIG      ENDPOINT_RECEIVE_ONLY
+  #define ENDPOINT4_CONFIG      ENDPOINT_TRANSMIT_ONLY
+
 #elif defined(USB_HID)
   #define VENDOR_ID		0x16C0
   #define PRODUCT_ID		0x0482
@@ -43,6 +43,7 @@
 #include "kinetis.h"
 //#include "HardwareSerial.h"
 #include "usb_mem.h"
+#include "usb_nsgamepad.h"
 #include <string.h> // for memset
 
 // This code has a known bug with compiled with -O2 optimization on gcc 5.4.1
@@ -269,6 +270,9 @@ static void usb_setup(void)
 			}
 #endif
 		}
+#ifdef NSGAMEPAD_INTERFACE
+		usb_nsgamepad_configure();
+#endif
 		break;
 	  case 0x0880: // GET_CONFIGURATION
 		reply_buffer[0] = usb_configuration;
@@ -404,7 +408,8 @@ static void usb_setup(void)
 		break;
 #endif
 
-// TODO: this does not work... why?
+// The data of a SET_REPORT arrives in the following OUT packet, handled in
+// usb_control()
 #if defined(SEREMU_INTERFACE) || defined(KEYBOARD_INTERFACE) || defined(JOYSTICK_INTERFACE) || defined(NSGAMEPAD_INTERFACE)
 	  case 0x0921: // HID SET_REPORT
 		//serial_print(":)\n");
@@ -651,6 +656,12 @@ static void usb_control(uint32_t stat)
 			endpoint0_transmit(NULL, 0);
 		}
 #endif
+#ifdef NSGAMEPAD_INTERFACE
+		if (setup.word1 == 0x02000921 && setup.wIndex == NSGAMEPAD_INTERFACE) {
+			usb_nsgamepad_output_report(buf, b->desc >> 16);
+			endpoint0_transmit(NULL, 0);
+		}
+#endif
 #ifdef SEREMU_INTERFACE
 		if (setup.word1 == 0x03000921 && setup.word2 == ((4<<16)|SEREMU_INTERFACE)
 		  && buf[0] == 0xA9 && buf[1] == 0x45 && buf[2] == 0xC2 && buf[3] == 0x6B) {
@@ -954,6 +965,9 @@ void usb_isr(void)
 #endif
 #ifdef MULTITOUCH_INTERFACE
 			usb_touchscreen_update_callback();
+#endif
+#ifdef NSGAMEPAD_INTERFACE
+			usb_nsgamepad_sof_callback();
 #endif
 		}
 		USB0_ISTAT = USB_ISTAT_SOFTOK;
@@ -1007,6 +1021,9 @@ void usb_isr(void)
 #endif
 			if (stat & 0x08) { // transmit
 				usb_free(packet);
+#ifdef NSGAMEPAD_INTERFACE
+				if (endpoint == NSGAMEPAD_ENDPOINT-1) usb_nsgamepad_tx_callback();
+#endif
 				packet = tx_first[endpoint];
 				if (packet) {
 					//serial_print("tx packet\n");
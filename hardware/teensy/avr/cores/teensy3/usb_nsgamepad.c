@@ -43,6 +43,25 @@
 
 uint32_t usb_nsgamepad_data[(NSGAMEPAD_REPORT_SIZE+3)/4];
 
+// Reports published by usb_nsgamepad_commit().  The sketch edits
+// usb_nsgamepad_data, then commit copies it into the buffer the transmit
+// path is not reading and publishes it with a single store to report_seq.
+// Readers copy the buffer selected by the low bit and retry if report_seq
+// changed meanwhile, which only happens when an interrupt commits.
+static uint32_t report_buf[2][(NSGAMEPAD_REPORT_SIZE+3)/4];
+static volatile uint32_t report_seq=0;
+
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+// Input to USB latency.  stage_stamp is the time of the first change to
+// usb_nsgamepad_data since the last commit.  Each published report keeps the
+// oldest input it carries that the host has not yet read.
+static uint32_t stage_stamp=0;
+static uint32_t report_stamp[2];
+static volatile uint32_t report_sent_seq=0;
+static volatile uint32_t latency_hist[NSGAMEPAD_LATENCY_BUCKETS];
+static volatile uint32_t latency_max=0;
+#endif
+
 
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
 #define TX_PACKET_LIMIT 3
@@ -77,6 +96,369 @@ static uint8_t transmit_previous_timeout=0;
   #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
 #endif
 
+// Start of frame sync.  When enabled, reports are queued from the USB
+// interrupt one SOF before the host is due to poll the endpoint.  The
+// host's polling phase is taken from the completion of the previous report.
+#define SOF_LEAD 1
+static volatile uint8_t sof_sync=0;
+static uint16_t sof_count=0;
+
+// Reports handed to usb_tx() and reports the host has read.  Each counter
+// has a single writer, so their difference is safe to read anywhere.
+static volatile uint8_t tx_queued=0;
+static volatile uint8_t tx_done=0;
+// Copies of the queued reports for tx_sent_callback, ring indexed the same way
+static uint32_t tx_report[8][(NSGAMEPAD_REPORT_SIZE+3)/4];
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+// Packets complete in order, so their stamps are a ring indexed by the counters
+static uint32_t tx_stamp[8];
+#if defined(KINETISK)
+#define TIMESTAMP() ARM_DWT_CYCCNT
+#define TIMESTAMP_PER_USEC (F_CPU / 1000000)
+#else
+#define TIMESTAMP() micros()
+#define TIMESTAMP_PER_USEC 1
+#endif
+static void latency_record(uint32_t stamp);
+#endif
+
+// Sketch function called from the USB interrupt when the host reads a report
+static void (*tx_complete_callback)(void) = NULL;
+// Sketch function given each report the host reads, from the USB interrupt
+static void (*tx_sent_callback)(const void *report) = NULL;
+
+// Sketch function given each output report the host sends with SET_REPORT
+static void (*output_callback)(const uint8_t *data, uint32_t len) = NULL;
+// Sketch function that can stage and commit changes just before each
+// report is read for transmit
+static void (*update_callback)(void) = NULL;
+// Sketch function that can change each report just before it is queued
+static void (*build_callback)(void *report) = NULL;
+
+// Latest wins mode.  Only one report is given to the USB controller at a
+// time.  A newer report sent while it waits for the host replaces any
+// pending report and is transmitted when the host reads the current one.
+static volatile uint8_t latest_wins=0;
+static volatile uint8_t tx_pending=0;
+static volatile uint32_t tx_superseded=0;
+
+// Pulse stretching.  The sketch side counts the transitions of each button
+// as it changes the report, and each commit publishes the counts with the
+// report.  Queuing a report takes the transitions counted since the last
+// one, so none is missed however a commit and a transmit interleave.  A
+// button with transitions left shows one per report: a tap is sent as a
+// press, then a release in the next report.  At most one transition waits,
+// so a later change is never held back more than one report.
+#define PULSE_BUTTONS 16
+static volatile uint8_t pulse_stretch=0;
+static uint16_t stage_buttons=0;
+static uint8_t stage_count[PULSE_BUTTONS];     // transitions, written by the sketch
+static uint8_t report_count[2][PULSE_BUTTONS];
+static uint8_t tx_count[PULSE_BUTTONS];        // transitions already queued
+static uint16_t pulse_due=0;        // buttons with one transition left to send
+static uint16_t tx_buttons=0;       // buttons of the last queued report
+
+
+void usb_nsgamepad_commit(void)
+{
+    uint32_t seq = report_seq + 1;
+    usb_nsgamepad_stage_buttons(_report->buttons);
+    memcpy(report_count[seq & 1], stage_count, PULSE_BUTTONS);
+    memcpy(report_buf[seq & 1], usb_nsgamepad_data, NSGAMEPAD_REPORT_SIZE);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    uint32_t stamp = report_stamp[(seq - 1) & 1];
+    if (report_sent_seq == seq - 1 || stamp == 0) stamp = stage_stamp;
+    report_stamp[seq & 1] = stamp;
+    stage_stamp = 0;
+#endif
+    __asm__ volatile("" ::: "memory");
+    report_seq = seq;
+}
+
+
+void usb_nsgamepad_stage_buttons(uint16_t buttons)
+{
+    for (uint32_t e = buttons ^ stage_buttons; e; e &= e - 1) {
+        stage_count[__builtin_ctz(e)]++;
+    }
+    stage_buttons = buttons;
+}
+
+
+// Buttons to queue, one transition per button per report.  A tap counts
+// two transitions, more than two left over fold to one or two of the same
+// parity so the report still ends at the committed buttons.
+static uint16_t stretch_pulses(const uint8_t *count)
+{
+    uint16_t flip = 0;
+    for (int i = 0; i < PULSE_BUTTONS; i++) {
+        uint32_t n = (uint8_t)(count[i] - tx_count[i]) + ((pulse_due >> i) & 1);
+        tx_count[i] = count[i];
+        if (n == 0) continue;
+        if (n > 2) n = 2 - (n & 1);
+        flip |= 1 << i;
+        if (n == 2) pulse_due |= 1 << i;
+        else pulse_due &= ~(1 << i);
+    }
+    tx_buttons ^= flip;
+    return tx_buttons;
+}
+
+
+// Copies the newest report for transmit, with pulse stretching.  Returns
+// the input timestamp of the report, or 0 if it was already sent.
+static uint32_t read_report(void *buffer)
+{
+    uint32_t seq, stamp=0;
+    uint8_t count[PULSE_BUTTONS];
+    do {
+        seq = report_seq;
+        memcpy(buffer, report_buf[seq & 1], NSGAMEPAD_REPORT_SIZE);
+        memcpy(count, report_count[seq & 1], PULSE_BUTTONS);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+        stamp = report_stamp[seq & 1];
+#endif
+        __asm__ volatile("" ::: "memory");
+    } while (seq != report_seq);
+    HID_NSGamepadReport_Data_t *report = (HID_NSGamepadReport_Data_t *)buffer;
+    if (pulse_stretch) {
+        report->buttons = stretch_pulses(count);
+    } else {
+        memcpy(tx_count, count, PULSE_BUTTONS);
+        pulse_due = 0;
+        tx_buttons = report->buttons;
+    }
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    if (report_sent_seq == seq) stamp = 0;
+    report_sent_seq = seq;
+#endif
+    return stamp;
+}
+
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+uint32_t usb_nsgamepad_timestamp(void)
+{
+    return TIMESTAMP();
+}
+
+
+void usb_nsgamepad_stamp(uint32_t timestamp)
+{
+    timestamp |= 1; // 0 means no input
+    if (!stage_stamp || (int32_t)(timestamp - stage_stamp) < 0) {
+        stage_stamp = timestamp;
+    }
+}
+
+
+// called by the USB interrupt when the host has read a report
+static void latency_record(uint32_t stamp)
+{
+    if (!stamp) return;
+    uint32_t usec = (TIMESTAMP() - stamp) / TIMESTAMP_PER_USEC;
+    uint32_t bucket = usec / NSGAMEPAD_LATENCY_BUCKET_USEC;
+    if (bucket >= NSGAMEPAD_LATENCY_BUCKETS) bucket = NSGAMEPAD_LATENCY_BUCKETS - 1;
+    latency_hist[bucket]++;
+    if (usec > latency_max) latency_max = usec;
+}
+
+
+void usb_nsgamepad_latency_read(uint32_t *buckets)
+{
+    for (int i=0; i < NSGAMEPAD_LATENCY_BUCKETS; i++) {
+        buckets[i] = latency_hist[i];
+    }
+}
+
+
+uint32_t usb_nsgamepad_latency_max(void)
+{
+    return latency_max;
+}
+
+
+void usb_nsgamepad_latency_reset(void)
+{
+    for (int i=0; i < NSGAMEPAD_LATENCY_BUCKETS; i++) {
+        latency_hist[i] = 0;
+    }
+    latency_max = 0;
+}
+#endif
+
+
+static void transmit(usb_packet_t *tx_packet)
+{
+    if (update_callback) (*update_callback)();
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    tx_stamp[tx_queued & 7] = read_report(tx_packet->buf);
+#else
+    read_report(tx_packet->buf);
+#endif
+    if (build_callback) (*build_callback)(tx_packet->buf);
+    memcpy(tx_report[tx_queued & 7], tx_packet->buf, NSGAMEPAD_REPORT_SIZE);
+    tx_packet->len = NSGAMEPAD_REPORT_SIZE;
+    tx_queued++;
+    usb_tx(NSGAMEPAD_ENDPOINT, tx_packet);
+}
+
+
+void usb_nsgamepad_sof_sync(int enable)
+{
+    if (enable) sof_count = 0;
+    sof_sync = enable ? 1 : 0;
+}
+
+
+int usb_nsgamepad_sof_sync_enabled(void)
+{
+    return sof_sync;
+}
+
+
+// Full speed only, so bInterval is always a count of 1 ms frames
+uint32_t usb_nsgamepad_interval_usec(void)
+{
+    return NSGAMEPAD_INTERVAL * 1000;
+}
+
+
+// called by the USB interrupt at every start of frame
+void usb_nsgamepad_sof_callback(void)
+{
+    usb_packet_t *tx_packet;
+
+    if (!sof_sync) return;
+    if (sof_count < 0xFFFF) sof_count++;
+    if (sof_count + SOF_LEAD < NSGAMEPAD_INTERVAL) return;
+    // only one report may wait for the host, so it is always the newest
+    if (tx_queued != tx_done) {
+        // a bus reset without a new configuration leaves them outstanding
+        if (sof_count < TX_TIMEOUT_MSEC) return;
+        tx_done = tx_queued;
+    }
+    tx_packet = usb_malloc();
+    if (!tx_packet) return;
+    transmit(tx_packet);
+}
+
+
+// called by the USB interrupt when the host has read a report
+void usb_nsgamepad_tx_callback(void)
+{
+    usb_packet_t *tx_packet;
+
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    latency_record(tx_stamp[tx_done & 7]);
+#endif
+    if (tx_sent_callback) (*tx_sent_callback)(tx_report[tx_done & 7]);
+    tx_done++;
+    sof_count = 0;
+    if (tx_pending && tx_queued == tx_done) {
+        tx_packet = usb_malloc();
+        if (tx_packet) {
+            tx_pending = 0;
+            transmit(tx_packet);
+        }
+    }
+    if (tx_complete_callback) (*tx_complete_callback)();
+}
+
+
+void usb_nsgamepad_set_tx_callback(void (*fptr)(void))
+{
+    tx_complete_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_sent_callback(void (*fptr)(const void *report))
+{
+    tx_sent_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_output_callback(void (*fptr)(const uint8_t *data, uint32_t len))
+{
+    output_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_update_callback(void (*fptr)(void))
+{
+    update_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_build_callback(void (*fptr)(void *report))
+{
+    build_callback = fptr;
+}
+
+
+// called by the USB interrupt when a SET_REPORT data stage completes
+void usb_nsgamepad_output_report(const uint8_t *data, uint32_t len)
+{
+    if (len > NSGAMEPAD_OUTPUT_SIZE) len = NSGAMEPAD_OUTPUT_SIZE;
+    if (output_callback) (*output_callback)(data, len);
+}
+
+
+void usb_nsgamepad_latest_wins(int enable)
+{
+    latest_wins = enable ? 1 : 0;
+}
+
+
+uint32_t usb_nsgamepad_superseded_count(void)
+{
+    return tx_superseded;
+}
+
+
+void usb_nsgamepad_pulse_stretch(int enable)
+{
+    pulse_stretch = enable ? 1 : 0;
+}
+
+
+// Called from the USB interrupt when the host sets the configuration.  The
+// endpoint's queued packets were freed without completing, so no report is
+// waiting for the host any more.
+void usb_nsgamepad_configure(void)
+{
+    tx_done = tx_queued;
+    tx_pending = 0;
+    sof_count = 0;
+#if NSGAMEPAD_LATENCY_HISTOGRAM && defined(KINETISK)
+    // the stamps count CPU cycles, before the sketch can take any
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+
+static int send_latest(void)
+{
+    usb_packet_t *tx_packet;
+
+    __disable_irq();
+    if (tx_queued != tx_done) {
+        // the host has not read the previous report, tx_callback sends this one
+        if (tx_pending) tx_superseded++;
+        tx_pending = 1;
+        __enable_irq();
+        return NSGAMEPAD_SEND_QUEUED;
+    }
+    tx_packet = usb_malloc();
+    if (!tx_packet) {
+        __enable_irq();
+        return NSGAMEPAD_SEND_BUSY;
+    }
+    tx_pending = 0;
+    transmit(tx_packet);
+    __enable_irq();
+    return NSGAMEPAD_SEND_QUEUED;
+}
 
 
 int usb_nsgamepad_send(void)
@@ -84,6 +466,12 @@ int usb_nsgamepad_send(void)
     uint32_t wait_count=0;
     usb_packet_t *tx_packet;
 
+    // in sync mode the next start of frame sends the report
+    if (sof_sync) return usb_configuration ? 0 : -1;
+    if (latest_wins) {
+        if (!usb_configuration) return -1;
+        return (send_latest() == NSGAMEPAD_SEND_QUEUED) ? 0 : -1;
+    }
     while (1) {
         if (!usb_configuration) {
             return -1;
@@ -99,11 +487,27 @@ int usb_nsgamepad_send(void)
         yield();
     }
     transmit_previous_timeout = 0;
-    memcpy(tx_packet->buf, usb_nsgamepad_data, NSGAMEPAD_REPORT_SIZE);
-    tx_packet->len = NSGAMEPAD_REPORT_SIZE;
-    usb_tx(NSGAMEPAD_ENDPOINT, tx_packet);
+    transmit(tx_packet);
     return 0;
 }
 
+
+// Same as usb_nsgamepad_send(), but never waits for a free packet.
+int usb_nsgamepad_send_nowait(void)
+{
+    usb_packet_t *tx_packet;
+
+    if (!usb_configuration) return NSGAMEPAD_SEND_NOT_CONFIGURED;
+    if (sof_sync) return NSGAMEPAD_SEND_QUEUED;
+    if (latest_wins) return send_latest();
+    if (usb_tx_packet_count(NSGAMEPAD_ENDPOINT) >= TX_PACKET_LIMIT) {
+        return NSGAMEPAD_SEND_BUSY;
+    }
+    tx_packet = usb_malloc();
+    if (!tx_packet) return NSGAMEPAD_SEND_BUSY;
+    transmit(tx_packet);
+    return NSGAMEPAD_SEND_QUEUED;
+}
+
 #endif // F_CPU
 #endif // NSGAMEPAD_INTERFACE
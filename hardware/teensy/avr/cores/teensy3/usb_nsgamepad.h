@@ -40,16 +40,61 @@
 
 #include <inttypes.h>
 
+// Set to 1 to measure the time from the first input change carried by a
+// report until the host has read it.  The results are a histogram of
+// NSGAMEPAD_LATENCY_BUCKETS buckets, NSGAMEPAD_LATENCY_BUCKET_USEC wide.
+// Set it for the whole build, with the "NS Latency Histogram" menu, so the
+// core and the libraries agree.
+#ifndef NSGAMEPAD_LATENCY_HISTOGRAM
+#define NSGAMEPAD_LATENCY_HISTOGRAM 0
+#endif
+#define NSGAMEPAD_LATENCY_BUCKETS 64
+#define NSGAMEPAD_LATENCY_BUCKET_USEC 250
+
 // C language implementation
 #ifdef __cplusplus
 extern "C" {
 #endif
+void usb_nsgamepad_configure(void);
 int usb_nsgamepad_send(void);
+void usb_nsgamepad_commit(void);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+uint32_t usb_nsgamepad_timestamp(void);
+void usb_nsgamepad_stamp(uint32_t timestamp);
+void usb_nsgamepad_latency_read(uint32_t *buckets);
+uint32_t usb_nsgamepad_latency_max(void);
+void usb_nsgamepad_latency_reset(void);
+#endif
+int usb_nsgamepad_send_nowait(void);
+void usb_nsgamepad_set_tx_callback(void (*fptr)(void));
+void usb_nsgamepad_set_sent_callback(void (*fptr)(const void *report));
+void usb_nsgamepad_set_output_callback(void (*fptr)(const uint8_t *data, uint32_t len));
+void usb_nsgamepad_set_update_callback(void (*fptr)(void));
+void usb_nsgamepad_set_build_callback(void (*fptr)(void *report));
+void usb_nsgamepad_output_report(const uint8_t *data, uint32_t len);
+void usb_nsgamepad_latest_wins(int enable);
+uint32_t usb_nsgamepad_superseded_count(void);
+void usb_nsgamepad_pulse_stretch(int enable);
+void usb_nsgamepad_stage_buttons(uint16_t buttons);
+void usb_nsgamepad_sof_sync(int enable);
+int usb_nsgamepad_sof_sync_enabled(void);
+uint32_t usb_nsgamepad_interval_usec(void);
+void usb_nsgamepad_sof_callback(void);
+void usb_nsgamepad_tx_callback(void);
 extern uint32_t usb_nsgamepad_data[(NSGAMEPAD_REPORT_SIZE+3)/4];
+extern volatile uint8_t usb_configuration;
 #ifdef __cplusplus
 }
 #endif
 
+// Bytes in the vendor output report the host may send with SET_REPORT
+#define NSGAMEPAD_OUTPUT_SIZE 8
+
+// usb_nsgamepad_send_nowait() results
+#define NSGAMEPAD_SEND_QUEUED 0
+#define NSGAMEPAD_SEND_BUSY 1
+#define NSGAMEPAD_SEND_NOT_CONFIGURED -1
+
 // Dpad directions
 #define NSGAMEPAD_DPAD_CENTERED 0xF
 #define NSGAMEPAD_DPAD_UP 0
@@ -102,7 +147,7 @@ class usb_nsgamepad_class
     public:
         void begin(void) {
             end();
-            startMillis = millis();
+            startMicros = micros();
         };
         void end(void) {
             // release all buttons and center all axes
@@ -110,20 +155,34 @@ class usb_nsgamepad_class
             _report->leftXAxis = _report->leftYAxis = 0x80;
             _report->rightXAxis = _report->rightYAxis = 0x80;
             _report->dPad = NSGAMEPAD_DPAD_CENTERED;
+            commit();
             usb_nsgamepad_send();
         };
+        // Changes made between beginUpdate() and commit() reach the host
+        // together.  Outside of an update every change is sent on its own.
+        void beginUpdate(void) {
+            updating = true;
+            __asm__ volatile("" ::: "memory");
+        };
+        void commit(void) {
+            usb_nsgamepad_commit();
+            updating = false;
+        };
+        // Send reports from the USB start of frame interrupt, timed to the
+        // host's polling interval.  loop() and write() are then not needed.
+        void useSOFSync(bool enable) {
+            usb_nsgamepad_sof_sync(enable);
+        };
+        // Host polling interval in microseconds, from the configuration
+        // the host selected at enumeration.  loop() sends at this rate.
+        uint32_t interval(void) {
+            return usb_nsgamepad_interval_usec();
+        };
         void loop(void){
-            uint32_t endMillis = millis();
-            uint32_t deltaMillis;
-            if (endMillis >= startMillis) {
-                deltaMillis = (endMillis - startMillis);
-            }
-            else {
-                deltaMillis = ((0xFFFFFFFFUL - startMillis) + endMillis);
-            }
-            if (deltaMillis >= 1) {
+            if (usb_nsgamepad_sof_sync_enabled()) return;
+            if (micros() - startMicros >= usb_nsgamepad_interval_usec()) {
                 write();
-                startMillis = millis();
+                startMicros = micros();
             }
         };
         void write(void) {
@@ -131,37 +190,144 @@ class usb_nsgamepad_class
         };
         void write(void *report) {
             memcpy(_report, report, NSGAMEPAD_REPORT_SIZE);
+            commit();
             usb_nsgamepad_send();
         };
+        // Returns NSGAMEPAD_SEND_QUEUED, NSGAMEPAD_SEND_BUSY or
+        // NSGAMEPAD_SEND_NOT_CONFIGURED without waiting.
+        int tryWrite(void) {
+            return usb_nsgamepad_send_nowait();
+        };
+        // The function runs from the USB interrupt each time the host
+        // reads a report.  Keep it short.
+        void setHandleTransmitComplete(void (*fptr)(void)) {
+            usb_nsgamepad_set_tx_callback(fptr);
+        };
+        // fptr is given each report the host reads, as 8 bytes laid out
+        // like HID_NSGamepadReport_Data_t.  Called from the USB interrupt.
+        void setHandleReportSent(void (*fptr)(const void *report)) {
+            usb_nsgamepad_set_sent_callback(fptr);
+        };
+        // fptr is given the output report, up to NSGAMEPAD_OUTPUT_SIZE
+        // bytes, each time the host sends one.  Called from the USB
+        // interrupt as soon as the control transfer completes.  The host
+        // only sends them when NSGAMEPAD_OUTPUT_REPORT is set for the build.
+        void setHandleOutputReport(void (*fptr)(const uint8_t *data, uint32_t len)) {
+            usb_nsgamepad_set_output_callback(fptr);
+        };
+        // True between beginUpdate() and commit(), for a report update
+        // function to leave the report alone while loop() changes it
+        bool inUpdate(void) {
+            return updating;
+        };
+        // fptr runs just before each report is read for the host.  Changes
+        // it makes with the usual calls reach that report, pulse stretched
+        // like any other.  With SOF sync it runs from the USB interrupt, so
+        // it must skip its changes while inUpdate() is true.  Keep it short.
+        void setHandleReportUpdate(void (*fptr)(void)) {
+            usb_nsgamepad_set_update_callback(fptr);
+        };
+        // fptr can change each report, 8 bytes laid out like
+        // HID_NSGamepadReport_Data_t, just before it is queued for the host.
+        // With SOF sync it runs from the USB interrupt, so input captured by
+        // other interrupts reaches the host however long loop() takes.  Keep
+        // it short.
+        void setHandleReportBuild(void (*fptr)(void *report)) {
+            usb_nsgamepad_set_build_callback(fptr);
+        };
+        // Keep at most one report waiting for the host.  A newer report
+        // replaces a pending one instead of queuing behind it.
+        void useLatestWins(bool enable) {
+            usb_nsgamepad_latest_wins(enable);
+        };
+        // Number of pending reports replaced by a newer one
+        uint32_t supersededCount(void) {
+            return usb_nsgamepad_superseded_count();
+        };
+        // Every button press and release reaches the host.  A button that
+        // goes down and up again between two reports is sent pressed in the
+        // next report and released in the one after.
+        void usePulseStretch(bool enable) {
+            usb_nsgamepad_pulse_stretch(enable);
+        };
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+        // Copies NSGAMEPAD_LATENCY_BUCKETS counts.  The last bucket also
+        // counts every slower report.
+        void latencyHistogram(uint32_t *buckets) {
+            usb_nsgamepad_latency_read(buckets);
+        };
+        // Slowest input to USB latency in microseconds
+        uint32_t latencyMax(void) {
+            return usb_nsgamepad_latency_max();
+        };
+        void latencyReset(void) {
+            usb_nsgamepad_latency_reset();
+        };
+        // Mark pending changes with an earlier input time, such as when a
+        // controller report arrived.  Use usb_nsgamepad_timestamp().
+        void stampInput(uint32_t timestamp) {
+            usb_nsgamepad_stamp(timestamp);
+        };
+#endif
         void press(uint8_t b) {
             _report->buttons |= (uint16_t)1 << b;
+            changed();
         };
         void release(uint8_t b) {
             _report->buttons &= ~((uint16_t)1 << b);
+            changed();
         };
         void releaseAll(void) {
             _report->buttons = 0;
+            changed();
         };
         void buttons(uint16_t b) {
             _report->buttons = b;
+            changed();
         };
         void leftXAxis(uint8_t a) {
             _report->leftXAxis = a;
+            changed();
         };
         void leftYAxis(uint8_t a) {
             _report->leftYAxis = a;
+            changed();
         };
         void rightXAxis(uint8_t a) {
             _report->rightXAxis = a;
+            changed();
         };
         void rightYAxis(uint8_t a) {
             _report->rightYAxis = a;
+            changed();
         };
         void dPad(int8_t d) {
             _report->dPad = d;
+            changed();
+        };
+        // Presses the buttons in press, releases those in release and
+        // copies the report bytes selected by mask, bit n for byte n of
+        // HID_NSGamepadReport_Data_t, from report.  One change, so a
+        // controller's whole input report lands at once.
+        void applyChanges(uint16_t press, uint16_t release, const void *report, uint8_t mask) {
+            const uint8_t *src = (const uint8_t *)report;
+            uint8_t *dst = (uint8_t *)_report;
+            _report->buttons = (_report->buttons | press) & ~release;
+            for (int i = 2; i < NSGAMEPAD_REPORT_SIZE; i++) {
+                if (mask & (1 << i)) dst[i] = src[i];
+            }
+            changed();
         };
     protected:
-        uint32_t startMillis;
+        void changed(void) {
+            usb_nsgamepad_stage_buttons(_report->buttons);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+            usb_nsgamepad_stamp(usb_nsgamepad_timestamp());
+#endif
+            if (!updating) usb_nsgamepad_commit();
+        };
+        uint32_t startMicros;
+        volatile bool updating;
 };
 extern usb_nsgamepad_class NSGamepad;
 
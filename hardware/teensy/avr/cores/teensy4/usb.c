@@ -344,6 +344,9 @@ static void isr(void)
 		#ifdef FLIGHTSIM_INTERFACE
 		usb_flightsim_flush_output();
 		#endif
+		#ifdef NSGAMEPAD_INTERFACE
+		usb_nsgamepad_sof_callback();
+		#endif
 	}
 }
 
@@ -772,6 +775,11 @@ static void endpoint0_complete(void)
 		endpoint0_transmit(NULL, 0, 0);
 	}
 #endif
+#ifdef NSGAMEPAD_INTERFACE
+	if (setup.word1 == 0x02000921 && setup.wIndex == NSGAMEPAD_INTERFACE) {
+		usb_nsgamepad_output_report(endpoint0_buffer, setup.wLength);
+	}
+#endif
 #ifdef SEREMU_INTERFACE
 	if (setup.word1 == 0x03000921 && setup.word2 == ((4<<16)|SEREMU_INTERFACE)
 	  && endpoint0_buffer[0] == 0xA9 && endpoint0_buffer[1] == 0x45
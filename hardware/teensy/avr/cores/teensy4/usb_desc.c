@@ -378,6 +378,12 @@ static uint8_t joystick_report_desc[] = {
 #endif // JOYSTICK_INTERFACE
 
 #ifdef NSGAMEPAD_INTERFACE
+// Set to 1 to declare the 8 byte vendor output report, for rumble and LED
+// data from the NS.  Left out by default so the descriptor stays the plain
+// HORIPAD S one the NS recognizes.
+#ifndef NSGAMEPAD_OUTPUT_REPORT
+#define NSGAMEPAD_OUTPUT_REPORT 0
+#endif
 static uint8_t nsgamepad_report_desc[] = {
 // Gamepad for Nintendo Switch
 // 14 buttons, 1 8-way dpad, 2 analog sticks (4 axes)
@@ -419,6 +425,12 @@ static uint8_t nsgamepad_report_desc[] = {
         0x75, 0x08,                     //   Report Size (8)
         0x95, 0x01,                     //   Report Count (1)
         0x81, 0x01,                     //   Input (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position)
+#if NSGAMEPAD_OUTPUT_REPORT
+        0x06, 0x00, 0xFF,               //   Usage Page (Vendor Defined 0xFF00)
+        0x0A, 0x21, 0x26,               //   Usage (0x2621)
+        0x95, 0x08,                     //   Report Count (8)
+        0x91, 0x02,                     //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+#endif
         0xC0,                           // End Collection
 };
 #endif  // NSGAMEPAD_INTERFACE
@@ -1386,7 +1398,7 @@ PROGMEM const uint8_t usb_config_descriptor_480[CONFIG_DESC_SIZE] = {
         NSGAMEPAD_ENDPOINT | 0x80,              // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
         NSGAMEPAD_SIZE, 0,                      // wMaxPacketSize
-        NSGAMEPAD_INTERVAL,                     // bInterval
+        NSGAMEPAD_INTERVAL_480,                 // bInterval
 #endif // NSGAMEPAD_INTERFACE
 
 #ifdef MTP_INTERFACE
@@ -2401,7 +2413,7 @@ PROGMEM const uint8_t usb_config_descriptor_12[CONFIG_DESC_SIZE] = {
         NSGAMEPAD_ENDPOINT | 0x80,              // bEndpointAddress
         0x03,                                   // bmAttributes (0x03=intr)
         NSGAMEPAD_SIZE, 0,                      // wMaxPacketSize
-        NSGAMEPAD_INTERVAL,                     // bInterval
+        NSGAMEPAD_INTERVAL_12,                  // bInterval
 #endif // NSGAMEPAD_INTERFACE
 
 #ifdef MTP_INTERFACE
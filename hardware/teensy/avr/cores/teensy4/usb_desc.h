@@ -305,7 +305,33 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define NSGAMEPAD_ENDPOINT    2
   #define NSGAMEPAD_SIZE        64
   #define NSGAMEPAD_REPORT_SIZE 8
-  #define NSGAMEPAD_INTERVAL    5
+  #define NSGAMEPAD_INTERVAL_480 5    // 2^(5-1) microframes = 2 ms
+  #define NSGAMEPAD_INTERVAL_12 5     // 5 ms
+  #define ENDPOINT2_CONFIG      ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
+
+#elif defined(USB_NSGAMEPAD_LOWLATENCY)
+  #define DEVICE_CLASS          0x00    // Defined at interface level
+  #define DEVICE_SUBCLASS       0x00
+  #define DEVICE_PROTOCOL       0x00
+  #define BCD_DEVICE            0x0572  // 5.72
+  #define DEVICE_ATTRIBUTES     0x80    // Bus powered
+  #define DEVICE_POWER          0xFA    // 500 mA
+  #define VENDOR_ID             0x0F0D
+  #define PRODUCT_ID            0x00C1
+  #define MANUFACTURER_NAME     {'H','O','R','I',' ','C','O','.',',','L','T','D','.'}
+  #define MANUFACTURER_NAME_LEN	13
+  #define PRODUCT_NAME          {'H','O','R','I','P','A','D',' ','S'}
+  #define PRODUCT_NAME_LEN      9
+  #define EP0_SIZE              64
+  #define NUM_ENDPOINTS         2
+  #define NUM_USB_BUFFERS       14
+  #define NUM_INTERFACE         1
+  #define NSGAMEPAD_INTERFACE   0
+  #define NSGAMEPAD_ENDPOINT    2
+  #define NSGAMEPAD_SIZE        64
+  #define NSGAMEPAD_REPORT_SIZE 8
+  #define NSGAMEPAD_INTERVAL_480 1    // every 125 us microframe
+  #define NSGAMEPAD_INTERVAL_12 1     // every 1 ms frame
   #define ENDPOINT2_CONFIG      ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
 
 #elif defined(USB_SERIAL_NSGAMEPAD)
@@ -337,7 +363,8 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define NSGAMEPAD_ENDPOINT    4
   #define NSGAMEPAD_SIZE        64
   #define NSGAMEPAD_REPORT_SIZE 8
-  #define NSGAMEPAD_INTERVAL    5
+  #define NSGAMEPAD_INTERVAL_480 5    // 2^(5-1) microframes = 2 ms
+  #define NSGAMEPAD_INTERVAL_12 5     // 5 ms
   #define ENDPOINT2_CONFIG      ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
   #define ENDPOINT3_CONFIG      ENDPOINT_RECEIVE_BULK + ENDPOINT_TRANSMIT_BULK
   #define ENDPOINT4_CONFIG      ENDPOINT_RECEIVE_UNUSED + ENDPOINT_TRANSMIT_INTERRUPT
@@ -45,6 +45,25 @@
 
 uint32_t usb_nsgamepad_data[(NSGAMEPAD_REPORT_SIZE+3)/4];
 
+// Reports published by usb_nsgamepad_commit().  The sketch edits
+// usb_nsgamepad_data, then commit copies it into the buffer the transmit
+// path is not reading and publishes it with a single store to report_seq.
+// Readers copy the buffer selected by the low bit and retry if report_seq
+// changed meanwhile, which only happens when an interrupt commits.
+static uint32_t report_buf[2][(NSGAMEPAD_REPORT_SIZE+3)/4];
+static volatile uint32_t report_seq=0;
+
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+// Input to USB latency.  stage_stamp is the time of the first change to
+// usb_nsgamepad_data since the last commit.  Each published report keeps the
+// oldest input it carries that the host has not yet read.
+static uint32_t stage_stamp=0;
+static uint32_t report_stamp[2];
+static volatile uint32_t report_sent_seq=0;
+static volatile uint32_t latency_hist[NSGAMEPAD_LATENCY_BUCKETS];
+static volatile uint32_t latency_max=0;
+#endif
+
 static uint8_t transmit_previous_timeout=0;
 
 // When the PC isn't listening, how long do we wait before discarding data?
@@ -59,22 +78,375 @@ static uint8_t transmit_previous_timeout=0;
 static transfer_t tx_transfer[TX_NUM] __attribute__ ((used, aligned(32)));
 DMAMEM static uint8_t txbuffer[TX_NUM * TX_BUFSIZE] __attribute__ ((aligned(32)));
 static uint8_t tx_head=0;
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+static uint32_t tx_stamp[TX_NUM];
+#define TIMESTAMP() ARM_DWT_CYCCNT
+#define TIMESTAMP_PER_USEC (F_CPU_ACTUAL / 1000000)
+static void latency_record(uint32_t stamp);
+#endif
 #if NSGAMEPAD_REPORT_SIZE > TX_BUFSIZE
 #error "Internal error, transmit buffer size is too small for nsgamepad endpoint"
 #endif
 
+// Start of frame sync.  When enabled, reports are queued from the USB
+// interrupt one SOF before the host is due to poll the endpoint.  The
+// host's polling phase is taken from the completion of the previous report.
+// At 480 Mbit/sec a SOF arrives every 125 us microframe, so bInterval is
+// an exponent rather than a frame count.
+#define SOF_LEAD 1
+static volatile uint8_t sof_sync=0;
+static uint16_t sof_period=NSGAMEPAD_INTERVAL_12;
+static uint16_t sof_count=0;
+
+// Host polling interval of the configuration negotiated at enumeration
+static uint32_t interval_usec=NSGAMEPAD_INTERVAL_12 * 1000;
+
+// Sketch function called from the USB interrupt when the host reads a report
+static void (*tx_complete_callback)(void) = NULL;
+// Sketch function given each report the host reads, from the USB interrupt
+static void (*tx_sent_callback)(const void *report) = NULL;
+
+// Sketch function given each output report the host sends with SET_REPORT
+static void (*output_callback)(const uint8_t *data, uint32_t len) = NULL;
+// Sketch function that can stage and commit changes just before each
+// report is read for transmit
+static void (*update_callback)(void) = NULL;
+// Sketch function that can change each report just before it is queued
+static void (*build_callback)(void *report) = NULL;
+
+// Latest wins mode.  Only one report is given to the USB controller at a
+// time.  A newer report sent while it waits for the host replaces any
+// pending report and is transmitted when the host reads the current one.
+static volatile uint8_t latest_wins=0;
+static volatile uint8_t tx_pending=0;
+static volatile uint32_t tx_superseded=0;
+
+// Pulse stretching.  The sketch side counts the transitions of each button
+// as it changes the report, and each commit publishes the counts with the
+// report.  Queuing a report takes the transitions counted since the last
+// one, so none is missed however a commit and a transmit interleave.  A
+// button with transitions left shows one per report: a tap is sent as a
+// press, then a release in the next report.  At most one transition waits,
+// so a later change is never held back more than one report.
+#define PULSE_BUTTONS 16
+static volatile uint8_t pulse_stretch=0;
+static uint16_t stage_buttons=0;
+static uint8_t stage_count[PULSE_BUTTONS];     // transitions, written by the sketch
+static uint8_t report_count[2][PULSE_BUTTONS];
+static uint8_t tx_count[PULSE_BUTTONS];        // transitions already queued
+static uint16_t pulse_due=0;        // buttons with one transition left to send
+static uint16_t tx_buttons=0;       // buttons of the last queued report
+
+static void tx_callback(transfer_t *t);
+static void transmit(uint32_t head);
+static int send_latest(void);
+static uint32_t read_report(void *buffer);
+
 
 void usb_nsgamepad_configure(void)
 {
     memset(tx_transfer, 0, sizeof(tx_transfer));
     tx_head = 0;
-    usb_config_tx(NSGAMEPAD_ENDPOINT, NSGAMEPAD_REPORT_SIZE, 0, NULL);
+    tx_pending = 0;
+    if (usb_high_speed) {
+        sof_period = 1 << (NSGAMEPAD_INTERVAL_480 - 1);
+        interval_usec = sof_period * 125;
+    } else {
+        sof_period = NSGAMEPAD_INTERVAL_12;
+        interval_usec = sof_period * 1000;
+    }
+    sof_count = 0;
+    usb_config_tx(NSGAMEPAD_ENDPOINT, NSGAMEPAD_REPORT_SIZE, 0, tx_callback);
+}
+
+
+void usb_nsgamepad_commit(void)
+{
+    uint32_t seq = report_seq + 1;
+    usb_nsgamepad_stage_buttons(_report->buttons);
+    memcpy(report_count[seq & 1], stage_count, PULSE_BUTTONS);
+    memcpy(report_buf[seq & 1], usb_nsgamepad_data, NSGAMEPAD_REPORT_SIZE);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    uint32_t stamp = report_stamp[(seq - 1) & 1];
+    if (report_sent_seq == seq - 1 || stamp == 0) stamp = stage_stamp;
+    report_stamp[seq & 1] = stamp;
+    stage_stamp = 0;
+#endif
+    __asm__ volatile("" ::: "memory");
+    report_seq = seq;
+}
+
+
+void usb_nsgamepad_stage_buttons(uint16_t buttons)
+{
+    for (uint32_t e = buttons ^ stage_buttons; e; e &= e - 1) {
+        stage_count[__builtin_ctz(e)]++;
+    }
+    stage_buttons = buttons;
+}
+
+
+// Buttons to queue, one transition per button per report.  A tap counts
+// two transitions, more than two left over fold to one or two of the same
+// parity so the report still ends at the committed buttons.
+static uint16_t stretch_pulses(const uint8_t *count)
+{
+    uint16_t flip = 0;
+    for (int i = 0; i < PULSE_BUTTONS; i++) {
+        uint32_t n = (uint8_t)(count[i] - tx_count[i]) + ((pulse_due >> i) & 1);
+        tx_count[i] = count[i];
+        if (n == 0) continue;
+        if (n > 2) n = 2 - (n & 1);
+        flip |= 1 << i;
+        if (n == 2) pulse_due |= 1 << i;
+        else pulse_due &= ~(1 << i);
+    }
+    tx_buttons ^= flip;
+    return tx_buttons;
+}
+
+
+// Copies the newest report for transmit, with pulse stretching.  Returns
+// the input timestamp of the report, or 0 if it was already sent.
+static uint32_t read_report(void *buffer)
+{
+    uint32_t seq, stamp=0;
+    uint8_t count[PULSE_BUTTONS];
+    do {
+        seq = report_seq;
+        memcpy(buffer, report_buf[seq & 1], NSGAMEPAD_REPORT_SIZE);
+        memcpy(count, report_count[seq & 1], PULSE_BUTTONS);
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+        stamp = report_stamp[seq & 1];
+#endif
+        __asm__ volatile("" ::: "memory");
+    } while (seq != report_seq);
+    HID_NSGamepadReport_Data_t *report = (HID_NSGamepadReport_Data_t *)buffer;
+    if (pulse_stretch) {
+        report->buttons = stretch_pulses(count);
+    } else {
+        memcpy(tx_count, count, PULSE_BUTTONS);
+        pulse_due = 0;
+        tx_buttons = report->buttons;
+    }
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    if (report_sent_seq == seq) stamp = 0;
+    report_sent_seq = seq;
+#endif
+    return stamp;
+}
+
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+uint32_t usb_nsgamepad_timestamp(void)
+{
+    return TIMESTAMP();
+}
+
+
+void usb_nsgamepad_stamp(uint32_t timestamp)
+{
+    timestamp |= 1; // 0 means no input
+    if (!stage_stamp || (int32_t)(timestamp - stage_stamp) < 0) {
+        stage_stamp = timestamp;
+    }
+}
+
+
+// called by the USB interrupt when the host has read a report
+static void latency_record(uint32_t stamp)
+{
+    if (!stamp) return;
+    uint32_t usec = (TIMESTAMP() - stamp) / TIMESTAMP_PER_USEC;
+    uint32_t bucket = usec / NSGAMEPAD_LATENCY_BUCKET_USEC;
+    if (bucket >= NSGAMEPAD_LATENCY_BUCKETS) bucket = NSGAMEPAD_LATENCY_BUCKETS - 1;
+    latency_hist[bucket]++;
+    if (usec > latency_max) latency_max = usec;
+}
+
+
+void usb_nsgamepad_latency_read(uint32_t *buckets)
+{
+    for (int i=0; i < NSGAMEPAD_LATENCY_BUCKETS; i++) {
+        buckets[i] = latency_hist[i];
+    }
+}
+
+
+uint32_t usb_nsgamepad_latency_max(void)
+{
+    return latency_max;
+}
+
+
+void usb_nsgamepad_latency_reset(void)
+{
+    for (int i=0; i < NSGAMEPAD_LATENCY_BUCKETS; i++) {
+        latency_hist[i] = 0;
+    }
+    latency_max = 0;
+}
+#endif
+
+
+void usb_nsgamepad_sof_sync(int enable)
+{
+    if (enable) {
+        sof_count = 0;
+        sof_sync = 1;
+        usb_start_sof_interrupts(NSGAMEPAD_INTERFACE);
+    } else {
+        usb_stop_sof_interrupts(NSGAMEPAD_INTERFACE);
+        sof_sync = 0;
+    }
+}
+
+
+int usb_nsgamepad_sof_sync_enabled(void)
+{
+    return sof_sync;
+}
+
+
+uint32_t usb_nsgamepad_interval_usec(void)
+{
+    return interval_usec;
+}
+
+
+// called by the USB interrupt at every start of frame
+void usb_nsgamepad_sof_callback(void)
+{
+    if (!sof_sync || !usb_configuration) return;
+    if (sof_count < 0xFFFF) sof_count++;
+    if (sof_count + SOF_LEAD < sof_period) return;
+    // only one report may wait for the host, so it is always the newest
+    uint32_t head = tx_head;
+    uint32_t prev = (head == 0) ? TX_NUM - 1 : head - 1;
+    if (usb_transfer_status(tx_transfer + prev) & 0x80) return;
+    if (usb_transfer_status(tx_transfer + head) & 0x80) return;
+    transmit(head);
+}
+
+
+// called by the USB interrupt when the host has read a report
+static void tx_callback(transfer_t *t)
+{
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    latency_record(tx_stamp[t - tx_transfer]);
+#endif
+    if (tx_sent_callback) {
+        (*tx_sent_callback)(txbuffer + (t - tx_transfer) * TX_BUFSIZE);
+    }
+    sof_count = 0;
+    if (tx_pending) {
+        tx_pending = 0;
+        transmit(tx_head);
+    }
+    if (tx_complete_callback) (*tx_complete_callback)();
+}
+
+
+void usb_nsgamepad_set_tx_callback(void (*fptr)(void))
+{
+    tx_complete_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_sent_callback(void (*fptr)(const void *report))
+{
+    tx_sent_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_output_callback(void (*fptr)(const uint8_t *data, uint32_t len))
+{
+    output_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_update_callback(void (*fptr)(void))
+{
+    update_callback = fptr;
+}
+
+
+void usb_nsgamepad_set_build_callback(void (*fptr)(void *report))
+{
+    build_callback = fptr;
+}
+
+
+// called by the USB interrupt when a SET_REPORT data stage completes
+void usb_nsgamepad_output_report(const uint8_t *data, uint32_t len)
+{
+    if (len > NSGAMEPAD_OUTPUT_SIZE) len = NSGAMEPAD_OUTPUT_SIZE;
+    if (output_callback) (*output_callback)(data, len);
+}
+
+
+void usb_nsgamepad_latest_wins(int enable)
+{
+    latest_wins = enable ? 1 : 0;
+}
+
+
+uint32_t usb_nsgamepad_superseded_count(void)
+{
+    return tx_superseded;
+}
+
+
+void usb_nsgamepad_pulse_stretch(int enable)
+{
+    pulse_stretch = enable ? 1 : 0;
+}
+
+
+static int send_latest(void)
+{
+    uint32_t head = tx_head;
+    uint32_t prev = (head == 0) ? TX_NUM - 1 : head - 1;
+
+    __disable_irq();
+    if (usb_transfer_status(tx_transfer + prev) & 0x80) {
+        // the host has not read the previous report, tx_callback sends this one
+        if (tx_pending) tx_superseded++;
+        tx_pending = 1;
+        __enable_irq();
+        return NSGAMEPAD_SEND_QUEUED;
+    }
+    tx_pending = 0;
+    transmit(head);
+    __enable_irq();
+    return NSGAMEPAD_SEND_QUEUED;
+}
+
+
+static void transmit(uint32_t head)
+{
+    transfer_t *xfer = tx_transfer + head;
+    uint8_t *buffer = txbuffer + head * TX_BUFSIZE;
+    if (update_callback) (*update_callback)();
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+    tx_stamp[head] = read_report(buffer);
+#else
+    read_report(buffer);
+#endif
+    if (build_callback) (*build_callback)(buffer);
+    usb_prepare_transfer(xfer, buffer, NSGAMEPAD_REPORT_SIZE, 0);
+    arm_dcache_flush_delete(buffer, TX_BUFSIZE);
+    usb_transmit(NSGAMEPAD_ENDPOINT, xfer);
+    if (++head >= TX_NUM) head = 0;
+    tx_head = head;
 }
 
 
 int usb_nsgamepad_send()
 {
     if (!usb_configuration) return -1;
+    // in sync mode the next start of frame sends the report
+    if (sof_sync) return 0;
+    if (latest_wins) return send_latest();
     uint32_t head = tx_head;
     transfer_t *xfer = tx_transfer + head;
     uint32_t wait_begin_at = systick_millis_count;
@@ -103,15 +475,25 @@ int usb_nsgamepad_send()
         yield();
     }
     delayNanoseconds(30); // TODO: why is status ready too soon?
-    uint8_t *buffer = txbuffer + head * TX_BUFSIZE;
-    memcpy(buffer, usb_nsgamepad_data, NSGAMEPAD_REPORT_SIZE);
-    usb_prepare_transfer(xfer, buffer, NSGAMEPAD_REPORT_SIZE, 0);
-    arm_dcache_flush_delete(buffer, TX_BUFSIZE);
-    usb_transmit(NSGAMEPAD_ENDPOINT, xfer);
-    if (++head >= TX_NUM) head = 0;
-    tx_head = head;
+    transmit(head);
     return 0;
 }
 
 
+// Same as usb_nsgamepad_send(), but never waits for a free transfer.
+int usb_nsgamepad_send_nowait(void)
+{
+    if (!usb_configuration) return NSGAMEPAD_SEND_NOT_CONFIGURED;
+    if (sof_sync) return NSGAMEPAD_SEND_QUEUED;
+    if (latest_wins) return send_latest();
+    uint32_t head = tx_head;
+    if (usb_transfer_status(tx_transfer + head) & 0x80) {
+        return NSGAMEPAD_SEND_BUSY;
+    }
+    delayNanoseconds(30); // TODO: why is status ready too soon?
+    transmit(head);
+    return NSGAMEPAD_SEND_QUEUED;
+}
+
+
 #endif // NSGAMEPAD_INTERFACE
@@ -55,7 +55,7 @@ void yield(void)
 	running = 1;
 
 
-#if !defined(USB_JOYSTICK) && !defined(USB_NSGAMEPAD)
+#if !defined(USB_JOYSTICK) && !defined(USB_NSGAMEPAD) && !defined(USB_NSGAMEPAD_LOWLATENCY)
 	// USB Serail - Add hack to minimize impact...
 	if (yield_active_check_flags & YIELD_CHECK_USB_SERIAL) {
 		if (Serial.available()) serialEvent();
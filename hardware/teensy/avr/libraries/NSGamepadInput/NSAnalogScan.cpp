@@ -0,0 +1,136 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSAnalogScan.h"
+
+// ADC channel of A0 to A9 and how a conversion is started and read
+#if defined(KINETISL)
+static const uint8_t channel_of[10] = {5, 14, 8, 9, 13, 12, 6, 7, 15, 11};
+#elif defined(KINETISK)
+static const uint8_t channel_of[10] = {5, 14, 8, 9, 13, 12, 6, 7, 15, 4};
+#elif defined(__IMXRT1062__)
+static const uint8_t channel_of[10] = {7, 8, 12, 11, 6, 5, 15, 0, 13, 14};
+#endif
+
+#if defined(KINETISK) || defined(KINETISL)
+#define ADC_BACKGROUND 1
+#define ADC_IRQ IRQ_ADC0
+#define ADC_RESULT() ADC0_RA
+#define ADC_START(channel) (ADC0_SC1A = ADC_SC1_ADCH(channel) | ADC_SC1_AIEN)
+#define ADC_STOP() (ADC0_SC1A = ADC_SC1_ADCH(31))
+#elif defined(__IMXRT1062__)
+#define ADC_BACKGROUND 1
+#define ADC_IRQ IRQ_ADC1
+#define ADC_RESULT() ADC1_R0
+#define ADC_START(channel) (ADC1_HC0 = ADC_HC_ADCH(channel) | ADC_HC_AIEN)
+#define ADC_STOP() (ADC1_HC0 = ADC_HC_ADCH(31))
+#else
+#define ADC_BACKGROUND 0
+#endif
+
+// The scanner owning the ADC interrupt
+static NSAnalogScan *isr_scan = NULL;
+
+bool NSAnalogScan::begin(const uint8_t *pin_list, uint8_t count, uint8_t oversample)
+{
+    if (count == 0 || count > NSANALOG_PINS || (isr_scan && isr_scan != this)) return false;
+    end();
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t pin = (pin_list[i] >= 14) ? pin_list[i] - 14 : pin_list[i];
+        if (pin >= 10) return false;
+#if ADC_BACKGROUND
+        channel[i] = channel_of[pin];
+#else
+        channel[i] = pin_list[i];
+#endif
+    }
+    this->count = count;
+    shift = 0;
+    while (shift < 6 && ((uint8_t)1 << (shift + 1)) <= oversample) shift++;
+
+    // analogRead() sets up the ADC, waits for its calibration and gives
+    // the first values
+    analogReadResolution(10);
+    analogReadAveraging(NSANALOG_AVERAGING);
+    for (uint8_t i = 0; i < count; i++) {
+        latest[i] = analogRead(pin_list[i]);
+        sum[i] = 0;
+    }
+    current = round = 0;
+    published = 0;
+    running = true;
+#if ADC_BACKGROUND
+    isr_scan = this;
+    attachInterruptVector(ADC_IRQ, adc_isr);
+    NVIC_ENABLE_IRQ(ADC_IRQ);
+    ADC_START(channel[0]);
+#endif
+    return true;
+}
+
+void NSAnalogScan::end(void)
+{
+    if (!running) return;
+    running = false;
+#if ADC_BACKGROUND
+    NVIC_DISABLE_IRQ(ADC_IRQ);
+    ADC_STOP();
+    isr_scan = NULL;
+#endif
+}
+
+#if ADC_BACKGROUND
+void NSAnalogScan::adc_isr(void)
+{
+    NSAnalogScan *s = isr_scan;
+    uint16_t value = ADC_RESULT();
+    if (s == NULL) return;
+    s->sample(value);
+    ADC_START(s->channel[s->current]);
+}
+#endif
+
+void NSAnalogScan::update(void)
+{
+#if !ADC_BACKGROUND
+    if (running) sample(analogRead(channel[current]));
+#endif
+}
+
+// Adds a conversion of the current pin and moves on.  Every oversample
+// rounds the sums are rounded to 10 bits and published.
+void NSAnalogScan::sample(uint16_t value)
+{
+    sum[current] += value;
+    if (++current < count) return;
+    current = 0;
+    if (++round < ((uint8_t)1 << shift)) return;
+    round = 0;
+    uint32_t half = ((uint32_t)1 << shift) >> 1;
+    for (uint8_t i = 0; i < count; i++) {
+        latest[i] = (sum[i] + half) >> shift;
+        sum[i] = 0;
+    }
+    published++;
+}
@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSAnalogScan_h_
+#define NSAnalogScan_h_
+
+#include <Arduino.h>
+
+// Analog pins one scanner can convert
+#define NSANALOG_PINS 8
+// Samples the ADC averages in hardware for each conversion: 4, 8, 16 or 32
+#ifndef NSANALOG_AVERAGING
+#define NSANALOG_AVERAGING 16
+#endif
+
+// Converts analog pins continuously in the background, so reading a stick
+// axis is a load from memory instead of a blocking analogRead().
+//
+// begin() sets up ADC0 (ADC1 on Teensy 4) the way analogRead() does, with
+// hardware averaging, then starts the first conversion with its interrupt
+// enabled.  Each conversion complete interrupt adds the result to the pin's
+// sum and starts the next pin, round robin.  After oversample rounds the
+// sums are decimated into the latest values, which read() returns at once.
+// The values of different pins may come from rounds next to each other.
+// analogRead() must not be used on the same ADC while the scan runs.
+class NSAnalogScan
+{
+    public:
+        NSAnalogScan() : count(0), running(false), published(0) { };
+        // Pins as for analogRead(), A0 to A9.  oversample is the rounds
+        // summed into each value, a power of 2 up to 64.  Returns false if
+        // there are no pins, a pin has no ADC channel or another scanner is
+        // running.
+        bool begin(const uint8_t *pin_list, uint8_t count, uint8_t oversample = 4);
+        void end(void);
+        // Latest value of the nth pin, 0 to 1023, without waiting
+        uint16_t read(uint8_t index) { return latest[index]; };
+        // Rounds of values published since begin()
+        uint32_t rounds(void) { return published; };
+        // Converts the next pin with analogRead() on boards where the ADC
+        // cannot run in the background.  Does nothing on Teensy.
+        void update(void);
+    private:
+        static void adc_isr(void);
+        void sample(uint16_t value);
+        uint8_t count, current, shift;
+        uint8_t round;
+        bool running;
+        uint8_t channel[NSANALOG_PINS];
+        uint32_t sum[NSANALOG_PINS];
+        volatile uint16_t latest[NSANALOG_PINS];
+        volatile uint32_t published;
+};
+
+#endif // NSAnalogScan_h_
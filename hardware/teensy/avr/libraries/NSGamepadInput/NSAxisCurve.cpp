@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSAxisCurve.h"
+
+#define HALF (NSCURVE_SEGMENTS / 2)
+
+// Scale from input steps to table position, 16 bits of fraction, rounded
+// to nearest.  The end of the range lands within a fraction of a step of
+// the end of the table, and apply() clamps a position past it.
+static uint32_t segment_scale(uint32_t segments, uint32_t steps)
+{
+    if (steps == 0) return 0;
+    return ((segments << 16) + steps / 2) / steps;
+}
+
+// Response from 0 to 1 for a deflection from 0 to 1
+static float response(const NSAxisShape &shape, float m)
+{
+    float dead = shape.deadzone / 100.0f;
+    if (dead >= 1.0f) return 0.0f;
+    m = (m <= dead) ? 0.0f : (m - dead) / (1.0f - dead);
+    float y;
+    if (shape.points != NULL && shape.pointCount >= 2) {
+        float pos = m * (shape.pointCount - 1);
+        int i = (int)pos;
+        if (i >= shape.pointCount - 1) i = shape.pointCount - 2;
+        float f = pos - i;
+        y = (shape.points[i] + (shape.points[i + 1] - shape.points[i]) * f) / 255.0f;
+    }
+    else {
+        float e = shape.expo / 100.0f;
+        y = (1.0f - e) * m + e * m * m * m;
+    }
+    y = y * (shape.gain ? shape.gain : 100) / 100.0f;
+    return (y > 1.0f) ? 1.0f : y;
+}
+
+void NSAxisCurve::begin(const NSAxisShape &shape)
+{
+    in_min = shape.inMin;
+    in_max = (shape.inMax > shape.inMin) ? shape.inMax : shape.inMin + 1;
+    half = 0;
+    end = (uint32_t)NSCURVE_SEGMENTS << 16;
+    if (shape.inCenter > in_min && shape.inCenter < in_max) {
+        in_center = shape.inCenter;
+        scale_low = segment_scale(HALF, in_center - in_min);
+        scale_high = segment_scale(HALF, in_max - in_center);
+        half = (uint32_t)HALF << 16;
+    }
+    else {
+        in_center = in_min;
+        scale_low = 0;
+        scale_high = segment_scale(NSCURVE_SEGMENTS, in_max - in_min);
+    }
+
+    float out_min = shape.outMin;
+    float out_max = (shape.outMin == 0 && shape.outMax == 0) ? 255 : shape.outMax;
+    float mid = (out_min + out_max) / 2;
+    for (int i = 0; i <= NSCURVE_SEGMENTS; i++) {
+        float u = (float)(i - HALF) / HALF;
+        float y = response(shape, (u < 0) ? -u : u);
+        float out = mid + ((u < 0) ? -y : y) * (out_max - out_min) / 2;
+        table[i] = (uint16_t)(out * 256.0f + 0.5f);
+    }
+}
+
+void NSAxisCurve::begin(uint16_t maximum)
+{
+    NSAxisShape shape = {0, maximum};
+    begin(shape);
+}
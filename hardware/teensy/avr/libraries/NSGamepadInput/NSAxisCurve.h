@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSAxisCurve_h_
+#define NSAxisCurve_h_
+
+#include <Arduino.h>
+
+// Segments of the response table, an even number.  The table takes 2 bytes
+// per segment.
+#ifndef NSCURVE_SEGMENTS
+#if defined(__MKL26Z64__)
+#define NSCURVE_SEGMENTS 64
+#else
+#define NSCURVE_SEGMENTS 256
+#endif
+#endif
+
+// Input range and response of one axis
+typedef struct {
+    uint16_t inMin;
+    uint16_t inMax;
+    uint16_t inCenter;      // rest position, 0 for halfway between min and max
+    uint8_t deadzone;       // percent of deflection around the center that reads as centered
+    uint8_t expo;           // percent of cubic response, 0 for linear
+    uint8_t gain;           // percent, 0 for 100.  Above 100 full deflection is reached early.
+    uint8_t outMin;         // output at inMin, outMin 255 and outMax 0 inverts
+    uint8_t outMax;         // output at inMax, 0 for 255 when outMin is 0
+    // Custom response used instead of expo: pointCount outputs 0 to 255 for
+    // deflections spread evenly from the center to the end.
+    const uint8_t *points;
+    uint8_t pointCount;
+} NSAxisShape;
+
+// Converts raw axis values to NS axis values.  begin() bakes the range,
+// deadzone, curve, gain and inversion of an NSAxisShape into a piecewise
+// linear table in fixed point.  apply() then costs one multiply to find
+// the table segment and one interpolated lookup, with no division.
+class NSAxisCurve
+{
+    public:
+        void begin(const NSAxisShape &shape);
+        // Linear from 0 to maximum, the same as map(value, 0, maximum, 0, 255)
+        // but rounded
+        void begin(uint16_t maximum);
+        uint8_t apply(uint32_t value) const {
+            if (value < in_min) value = in_min;
+            if (value > in_max) value = in_max;
+            // table position, 16 bits of fraction
+            uint32_t pos = (value < in_center) ?
+                (value - in_min) * scale_low :
+                half + (value - in_center) * scale_high;
+            // the last entry has no segment after it to interpolate into
+            if (pos >= end) return (table[NSCURVE_SEGMENTS] + 0x80) >> 8;
+            uint32_t i = pos >> 16;
+            int32_t frac = (pos & 0xFFFF) >> 4;
+            int32_t y = table[i] + ((((int32_t)table[i + 1] - table[i]) * frac) >> 12);
+            return (y + 0x80) >> 8;
+        };
+    private:
+        uint16_t in_min, in_max, in_center;
+        uint32_t scale_low, scale_high;
+        uint32_t half, end;
+        // output at each segment end, 8 bits of fraction
+        uint16_t table[NSCURVE_SEGMENTS + 1];
+};
+
+#endif // NSAxisCurve_h_
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSAxisFilter.h"
+
+// Smoothing factor of a low pass at the cutoff, for calls at rate
+static float smoothing(float cutoff, float rate)
+{
+    float w = 2.0f * (float)M_PI * cutoff / rate;
+    return w / (1.0f + w);
+}
+
+void NSAxisFilter::begin(const NSFilterShape &shape)
+{
+    float rate = shape.rate ? shape.rate : 1000;
+    float min_cutoff = shape.minCutoff / 100.0f;
+    float beta = shape.beta / 1000.0f;
+    float d_cutoff = (shape.dCutoff ? shape.dCutoff : 100) / 100.0f;
+    d_alpha = (int32_t)(smoothing(d_cutoff, rate) * (1 << ALPHA_BITS) + 0.5f);
+
+    // The table ends at the speed where the factor reaches 0.99, in counts
+    // per call with 8 bits of fraction, and stays there past its end
+    shift = 0;
+    if (beta > 0) {
+        float fast = 99.0f * rate / (2.0f * (float)M_PI);
+        float speed = (fast - min_cutoff) / beta / rate * 256.0f;
+        while (shift < 16 && ((uint32_t)NSFILTER_STEPS << shift) < speed) shift++;
+    }
+    for (int i = 0; i <= NSFILTER_STEPS; i++) {
+        float speed = (float)((uint32_t)i << shift) / 256.0f * rate;
+        float alpha = smoothing(min_cutoff + beta * speed, rate);
+        alpha_table[i] = (uint16_t)(alpha * (1 << ALPHA_BITS) + 0.5f);
+    }
+    started = false;
+}
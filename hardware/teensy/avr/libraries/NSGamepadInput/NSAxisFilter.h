@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSAxisFilter_h_
+#define NSAxisFilter_h_
+
+#include <Arduino.h>
+
+// Steps of the speed to smoothing table
+#define NSFILTER_STEPS 32
+
+// Cutoffs of one axis filter
+typedef struct {
+    uint16_t rate;          // apply() calls per second
+    uint16_t minCutoff;     // cutoff at rest, hundredths of a Hz
+    uint16_t beta;          // cutoff added per unit per second of speed, thousandths of a Hz
+    uint16_t dCutoff;       // cutoff of the speed estimate, hundredths of a Hz, 0 for 1 Hz
+} NSFilterShape;
+
+// Adaptive low pass filter for one axis, after the One Euro filter.  The
+// cutoff rises with the axis speed: at rest it is minCutoff and jitter of a
+// count or two is smoothed away, moving fast it is high enough that the
+// output follows the input with next to no lag.
+//
+// begin() bakes the smoothing factor for each speed into a table.  apply()
+// then filters the speed, looks up the factor and filters the value, a
+// fixed handful of multiplies with no division.  Call it at the shape's
+// rate.  Values are 0 to 1023, kept with 8 bits of fraction.
+class NSAxisFilter
+{
+    public:
+        NSAxisFilter() : started(false) { };
+        void begin(const NSFilterShape &shape);
+        // Starts over from the next value
+        void reset(void) { started = false; };
+        uint16_t apply(uint16_t value) {
+            int32_t x = (int32_t)value << 8;
+            if (!started) {
+                x_hat = x;
+                dx_hat = 0;
+                started = true;
+                return value;
+            }
+            dx_hat += ((x - x_hat - dx_hat) * d_alpha + ROUND) >> ALPHA_BITS;
+            uint32_t speed = (dx_hat < 0) ? -dx_hat : dx_hat;
+            uint32_t i = speed >> shift;
+            int32_t alpha = alpha_table[NSFILTER_STEPS];
+            if (i < NSFILTER_STEPS) {
+                int32_t frac = speed & (((uint32_t)1 << shift) - 1);
+                alpha = alpha_table[i] +
+                    ((((int32_t)alpha_table[i + 1] - alpha_table[i]) * frac) >> shift);
+            }
+            x_hat += ((x - x_hat) * alpha + ROUND) >> ALPHA_BITS;
+            return (x_hat + 0x80) >> 8;
+        };
+    private:
+        // smoothing factors have 11 bits of fraction, so a change of a 10
+        // bit value with 8 bits of fraction times one fits in 31 bits
+        enum { ALPHA_BITS = 11, ROUND = 1 << (ALPHA_BITS - 1) };
+        bool started;
+        uint8_t shift;                                  // speed to table index
+        int32_t d_alpha;
+        int32_t x_hat, dx_hat;                          // value and speed per call, 8 bits of fraction
+        uint16_t alpha_table[NSFILTER_STEPS + 1];
+};
+
+#endif // NSAxisFilter_h_
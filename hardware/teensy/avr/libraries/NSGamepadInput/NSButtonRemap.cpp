@@ -0,0 +1,69 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSButtonRemap.h"
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// Up, right, down and left bits to dPad
+const uint8_t NSButtonRemap::dpad_map[16] = {
+                                // LDRU
+    NSGAMEPAD_DPAD_CENTERED,    // 0000
+    NSGAMEPAD_DPAD_UP,          // 0001
+    NSGAMEPAD_DPAD_RIGHT,       // 0010
+    NSGAMEPAD_DPAD_UP_RIGHT,    // 0011
+    NSGAMEPAD_DPAD_DOWN,        // 0100
+    NSGAMEPAD_DPAD_CENTERED,    // 0101 invalid
+    NSGAMEPAD_DPAD_DOWN_RIGHT,  // 0110
+    NSGAMEPAD_DPAD_CENTERED,    // 0111 invalid
+    NSGAMEPAD_DPAD_LEFT,        // 1000
+    NSGAMEPAD_DPAD_UP_LEFT,     // 1001
+    NSGAMEPAD_DPAD_CENTERED,    // 1010 invalid
+    NSGAMEPAD_DPAD_CENTERED,    // 1011 invalid
+    NSGAMEPAD_DPAD_DOWN_LEFT,   // 1100
+    NSGAMEPAD_DPAD_CENTERED,    // 1101 invalid
+    NSGAMEPAD_DPAD_CENTERED,    // 1110 invalid
+    NSGAMEPAD_DPAD_CENTERED,    // 1111 invalid
+};
+
+void NSButtonRemap::begin(const uint8_t *map, uint8_t count)
+{
+    memset(table, 0, sizeof(table));
+    dpad = false;
+    if (count > NSREMAP_BUTTONS) count = NSREMAP_BUTTONS;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t b = map ? map[i] : i;
+        if (b > NSMAP_DPAD_LEFT) continue;
+        // NSMAP_DPAD_UP is 0x10, so the dPad bits follow the buttons
+        uint32_t bit = (uint32_t)1 << b;
+        if (b >= NSMAP_DPAD_UP) dpad = true;
+        uint32_t *slice = table[i >> 3];
+        uint8_t in = 1 << (i & 7);
+        for (int v = 0; v < 256; v++) {
+            if (v & in) slice[v] |= bit;
+        }
+    }
+}
+
+#endif // NSGAMEPAD_INTERFACE
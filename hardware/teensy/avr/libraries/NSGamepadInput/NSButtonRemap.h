@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSButtonRemap_h_
+#define NSButtonRemap_h_
+
+#include <Arduino.h>
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// Bytes of the input button word that are remapped, 8 buttons each.  The
+// tables take 1 KB per byte, 4 KB per NSButtonRemap with 4.  Each
+// NSGamepadMap holds one next to its curves, about 8 KB in all, so the four
+// maps of NSPassthru take about 32 KB.  The Teensy LC default of 2 keeps
+// this to 2 KB per remap, and input bits 16 and up are then ignored: map
+// entries past NSREMAP_BUTTONS are dropped and those buttons never reach the
+// NS.  Set it for the whole build to change it.
+#ifndef NSREMAP_SLICES
+#if defined(__MKL26Z64__)
+#define NSREMAP_SLICES 2
+#else
+#define NSREMAP_SLICES 4
+#endif
+#endif
+#define NSREMAP_BUTTONS (NSREMAP_SLICES * 8)
+
+// Button map entries besides the NSButtons
+#define NSMAP_DPAD_UP 0x10
+#define NSMAP_DPAD_RIGHT 0x11
+#define NSMAP_DPAD_DOWN 0x12
+#define NSMAP_DPAD_LEFT 0x13
+#define NSMAP_UNUSED 0xFF
+
+// Remaps a button word, such as JoystickController::getButtons() or pins
+// read into a bit mask, to NS buttons.  begin() turns the map into one 256
+// entry table per input byte, so remap() costs one lookup per byte and
+// an OR, whatever buttons are pressed.  The result has the NS buttons in
+// bits 0 to 15, ready for NSGamepad.buttons(), and the dPad up, right, down
+// and left in bits 16 to 19, see dPad().
+class NSButtonRemap
+{
+    public:
+        // map gives the NS button or NSMAP_DPAD_* for each input bit, or
+        // NSMAP_UNUSED to ignore it.  NULL keeps the bit numbers.
+        void begin(const uint8_t *map, uint8_t count);
+        uint32_t remap(uint32_t buttons) const {
+            uint32_t bits = 0;
+            for (int i = 0; i < NSREMAP_SLICES; i++) {
+                bits |= table[i][(buttons >> (i * 8)) & 0xFF];
+            }
+            return bits;
+        };
+        // true if any input bit is mapped to the dPad
+        bool hasDPad(void) const { return dpad; };
+        // dPad direction of a remap() result
+        static uint8_t dPad(uint32_t bits) {
+            return dpad_map[(bits >> 16) & 0x0F];
+        };
+    private:
+        static const uint8_t dpad_map[16];
+        uint32_t table[NSREMAP_SLICES][256];
+        bool dpad;
+};
+
+#endif // NSGAMEPAD_INTERFACE
+
+#endif // NSButtonRemap_h_
@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSCalibration.h"
+
+// Shift of the center filter, the center moves 1/256 of the way to each
+// resting sample
+#define CENTER_SHIFT 8
+
+// Record: sequence, axis count, min, max and center of each axis, checksum
+static uint8_t checksum(const uint8_t *data, uint8_t len)
+{
+    uint8_t a = 0, b = 0;
+    while (len--) {
+        a += *data++;
+        b += a;
+    }
+    return a ^ b ^ 0x5A;
+}
+
+bool NSCalibration::begin(NSAxisShape *shapes, NSAxisCurve *curves, uint8_t count,
+        uint16_t address, uint16_t size)
+{
+    uint8_t record[NSCAL_RECORD_SIZE(NSCAL_AXES)];
+
+    if (count > NSCAL_AXES) count = NSCAL_AXES;
+    this->shapes = shapes;
+    this->curves = curves;
+    this->count = count;
+    this->address = address;
+    uint8_t len = NSCAL_RECORD_SIZE(count);
+    uint16_t n = size / len;
+    // the newest record is found by sequence number, which needs fewer
+    // slots than half the sequence range
+    slots = (n > 127) ? 127 : n;
+
+    // newest valid record
+    int newest = -1;
+    for (uint8_t i = 0; i < slots; i++) {
+        eeprom_read_block(record, (const void *)(uintptr_t)(address + i * len), len);
+        if (record[1] != count || checksum(record, len - 1) != record[len - 1]) continue;
+        if (newest < 0 || (int8_t)(record[0] - seq) > 0) {
+            newest = i;
+            seq = record[0];
+        }
+    }
+
+    was_loaded = false;
+    have_center = 0;
+    if (newest >= 0) {
+        slot = newest;
+        eeprom_read_block(record, (const void *)(uintptr_t)(address + slot * len), len);
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t *p = record + 2 + 6 * i;
+            uint16_t min = p[0] | (p[1] << 8);
+            uint16_t max = p[2] | (p[3] << 8);
+            uint16_t mid = p[4] | (p[5] << 8);
+            if (min >= max || mid < min || mid > max) continue;
+            shapes[i].inMin = min;
+            shapes[i].inMax = max;
+            shapes[i].inCenter = mid;
+            have_center |= 1 << i;
+            was_loaded = true;
+        }
+    }
+    else {
+        slot = slots - 1;
+        seq = 0xFF;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        center[i] = (uint32_t)shapes[i].inCenter << 8;
+        build(i);
+    }
+    rebuild = building = 0;
+    built_ms = millis() - NSCAL_REBUILD_MS;
+    unsaved = false;
+    return was_loaded;
+}
+
+void NSCalibration::build(uint8_t axis)
+{
+    curves[axis].begin(shapes[axis]);
+    near[axis] = (shapes[axis].inMax - shapes[axis].inMin) >> 5;
+}
+
+void NSCalibration::changed(uint8_t axis)
+{
+    rebuild |= 1 << axis;
+    unsaved = true;
+    changed_ms = millis();
+}
+
+uint8_t NSCalibration::read(uint8_t axis, uint16_t value)
+{
+    NSAxisShape &s = shapes[axis];
+    if (!((have_center >> axis) & 1)) {
+        // the sticks rest at power up
+        center[axis] = (uint32_t)value << 8;
+        s.inCenter = value;
+        have_center |= 1 << axis;
+        changed(axis);
+    }
+    if (value < s.inMin) {
+        s.inMin = value;
+        changed(axis);
+    }
+    else if (value > s.inMax) {
+        s.inMax = value;
+        changed(axis);
+    }
+    else {
+        uint16_t mid = center[axis] >> 8;
+        if (value + near[axis] >= mid && value <= mid + near[axis]) {
+            center[axis] += (int32_t)(((uint32_t)value << 8) - center[axis]) >> CENTER_SHIFT;
+            mid = center[axis] >> 8;
+            uint16_t d = (mid > s.inCenter) ? mid - s.inCenter : s.inCenter - mid;
+            if (d > (near[axis] >> 2) && mid > s.inMin && mid < s.inMax) {
+                s.inCenter = mid;
+                changed(axis);
+            }
+        }
+    }
+    return curves[axis].apply(value);
+}
+
+void NSCalibration::loop(void)
+{
+    // A sweep changes the range with every sample, so the stale axes are
+    // taken in rounds instead of rebuilding each curve on every pass
+    if (!building && rebuild && millis() - built_ms >= NSCAL_REBUILD_MS) {
+        building = rebuild;
+        rebuild = 0;
+        built_ms = millis();
+    }
+    if (building) {
+        uint8_t i = __builtin_ctz(building);
+        building &= ~(1 << i);
+        build(i);
+    }
+    else if (auto_save && saveDue()) {
+        save();
+    }
+}
+
+bool NSCalibration::saveDue(void)
+{
+    return unsaved && millis() - changed_ms >= NSCAL_SAVE_MS;
+}
+
+void NSCalibration::save(void)
+{
+    uint8_t record[NSCAL_RECORD_SIZE(NSCAL_AXES)];
+    uint8_t len = NSCAL_RECORD_SIZE(count);
+
+    if (slots == 0) return;
+    slot = (slot + 1 < slots) ? slot + 1 : 0;
+    record[0] = ++seq;
+    record[1] = count;
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t *p = record + 2 + 6 * i;
+        p[0] = shapes[i].inMin;
+        p[1] = shapes[i].inMin >> 8;
+        p[2] = shapes[i].inMax;
+        p[3] = shapes[i].inMax >> 8;
+        p[4] = shapes[i].inCenter;
+        p[5] = shapes[i].inCenter >> 8;
+    }
+    record[len - 1] = checksum(record, len - 1);
+    eeprom_write_block(record, (void *)(uintptr_t)(address + slot * len), len);
+    unsaved = false;
+}
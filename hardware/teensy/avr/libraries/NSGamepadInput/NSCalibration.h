@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSCalibration_h_
+#define NSCalibration_h_
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include "NSAxisCurve.h"
+
+// Axes one calibration can hold
+#define NSCAL_AXES 4
+// EEPROM bytes of one saved calibration
+#define NSCAL_RECORD_SIZE(count) (3 + 6 * (count))
+// A changed calibration is saved once the axes have not widened or moved
+// their center for this long
+#ifndef NSCAL_SAVE_MS
+#define NSCAL_SAVE_MS 5000
+#endif
+// While a stick sweeps, its curve is rebuilt at most this often
+#ifndef NSCAL_REBUILD_MS
+#define NSCAL_REBUILD_MS 50
+#endif
+
+// Learns the range and center of analog axes and keeps them in EEPROM, so
+// the sticks are calibrated from the first report after power up.
+//
+// begin() loads the newest saved calibration into the axis shapes and
+// builds their curves.  read() then widens the range with every sample and
+// follows the center while the stick rests near it, and apply()s the curve
+// with no division.  loop() rebuilds the curve of one changed axis per call,
+// a round of the changed axes every NSCAL_REBUILD_MS at most, and saves the
+// calibration once it settles.  Saves go round robin through
+// all the slots that fit the EEPROM region, so no byte is written more often
+// than every slots-th save.  A record that was cut short by a power loss
+// fails its checksum and the one before it is used.
+//
+// A save blocks until the EEPROM is written.  On Teensy 4 the EEPROM is
+// emulated in flash, and a save that erases a sector stalls everything,
+// interrupts too, for milliseconds.  To choose the moment, autoSave(false)
+// and call save() when saveDue(), for example while the NS is not polling.
+class NSCalibration
+{
+    public:
+        NSCalibration() : auto_save(true) { };
+        // shapes hold the defaults, used for axes with no saved calibration,
+        // and get the calibration.  Returns true if one was loaded.
+        bool begin(NSAxisShape *shapes, NSAxisCurve *curves, uint8_t count,
+                uint16_t address = 0, uint16_t size = E2END + 1);
+        uint8_t read(uint8_t axis, uint16_t value);
+        void loop(void);
+        void save(void);
+        // A changed calibration has settled and is not saved yet
+        bool saveDue(void);
+        // loop() saves when saveDue(), unless this is set to false
+        void autoSave(bool enable) { auto_save = enable; };
+        bool loaded(void) { return was_loaded; };
+    private:
+        void changed(uint8_t axis);
+        void build(uint8_t axis);
+        NSAxisShape *shapes;
+        NSAxisCurve *curves;
+        uint8_t count;
+        uint16_t address;
+        uint8_t slots, slot, seq;
+        bool was_loaded;
+        bool unsaved;
+        bool auto_save;
+        uint8_t rebuild;                // bit for each axis with a stale curve
+        uint8_t building;               // axes of the rebuild round under way
+        uint32_t built_ms;              // start of the last rebuild round
+        uint8_t have_center;            // bit for each axis with a known center
+        uint32_t changed_ms;
+        uint32_t center[NSCAL_AXES];    // rest position, 8 bits of fraction
+        uint16_t near[NSCAL_AXES];      // distance from the center that counts as resting
+};
+
+#endif // NSCalibration_h_
@@ -0,0 +1,196 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSGamepadMerge.h"
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// dPad direction to X and Y, -1 for left and up
+static const int8_t dpad_x[16] = {0, 1, 1, 1, 0, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+static const int8_t dpad_y[16] = {-1, -1, 0, 1, 1, 1, 0, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+// Sign of Y and X plus 1 to dPad direction
+static const uint8_t dpad_of[3][3] = {
+    {NSGAMEPAD_DPAD_UP_LEFT, NSGAMEPAD_DPAD_UP, NSGAMEPAD_DPAD_UP_RIGHT},
+    {NSGAMEPAD_DPAD_LEFT, NSGAMEPAD_DPAD_CENTERED, NSGAMEPAD_DPAD_RIGHT},
+    {NSGAMEPAD_DPAD_DOWN_LEFT, NSGAMEPAD_DPAD_DOWN, NSGAMEPAD_DPAD_DOWN_RIGHT},
+};
+
+static int sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+// Report bytes of a source at rest
+static void rest(uint8_t *report)
+{
+    memset(report, 0x80, NSGAMEPAD_REPORT_SIZE);
+    report[0] = report[1] = 0;
+    report[NSMERGE_DPAD] = NSGAMEPAD_DPAD_CENTERED;
+}
+
+void NSGamepadMerge::begin(uint8_t count)
+{
+    sources = (count < NSMERGE_SOURCES) ? count : NSMERGE_SOURCES;
+    memset(policies, NSMERGE_ANY, sizeof(policies));
+    memset(source_buttons, 0, sizeof(source_buttons));
+    memset(holders, 0, sizeof(holders));
+    held = 0;
+    for (uint8_t s = 0; s < NSMERGE_SOURCES; s++) clear(s);
+    memset(source_pressed, 0, sizeof(source_pressed));
+    memset(source_released, 0, sizeof(source_released));
+    merged_buttons = 0;
+    went_down = went_up = 0;
+    rest(merged);
+    dirty = false;
+}
+
+void NSGamepadMerge::policy(uint8_t field, uint8_t policy)
+{
+    if (field < NSGAMEPAD_REPORT_SIZE) policies[field] = policy;
+}
+
+// One more source holds the buttons
+void NSGamepadMerge::hold(uint16_t buttons)
+{
+    for (; buttons; buttons &= buttons - 1) {
+        uint8_t b = __builtin_ctz(buttons);
+        if (holders[b]++ == 0) {
+            held |= 1 << b;
+            went_down |= 1 << b;
+        }
+    }
+}
+
+// One source less holds the buttons
+void NSGamepadMerge::drop(uint16_t buttons)
+{
+    for (; buttons; buttons &= buttons - 1) {
+        uint8_t b = __builtin_ctz(buttons);
+        if (--holders[b] == 0) {
+            held &= ~(1 << b);
+            went_up |= 1 << b;
+        }
+    }
+}
+
+void NSGamepadMerge::applyChanges(uint8_t source, uint16_t press, uint16_t release,
+        const void *report, uint8_t mask)
+{
+    if (source >= sources) return;
+    const uint8_t *src = (const uint8_t *)report;
+    uint16_t old = source_buttons[source];
+    uint16_t now = (old | press) & ~release;
+    // A press released in the same change still goes down and up
+    uint16_t down = press & ~old;
+    uint16_t up = (old & ~now) | (down & release);
+    hold(down);
+    drop(up);
+    source_buttons[source] = now;
+    source_pressed[source] |= down;
+    source_released[source] |= up;
+    for (int i = NSMERGE_DPAD; i < NSGAMEPAD_REPORT_SIZE; i++) {
+        if (mask & (1 << i)) values[source][i] = src[i];
+    }
+    dirty = true;
+}
+
+void NSGamepadMerge::clear(uint8_t source)
+{
+    if (source >= NSMERGE_SOURCES) return;
+    drop(source_buttons[source]);
+    source_released[source] |= source_buttons[source];
+    source_buttons[source] = 0;
+    rest(values[source]);
+    dirty = true;
+}
+
+void NSGamepadMerge::update(void)
+{
+    if (!dirty) return;
+    dirty = false;
+
+    uint16_t bits = 0, both = 0;
+    if (policies[NSMERGE_BUTTONS] == NSMERGE_ANY) {
+        bits = held;
+        both = went_down & went_up;
+    }
+    int x = 0, y = 0;
+    uint8_t out[NSGAMEPAD_REPORT_SIZE];
+    memcpy(out, merged, sizeof(out));
+    for (int i = NSMERGE_DPAD; i <= NSMERGE_RIGHT_Y; i++) {
+        out[i] = (i == NSMERGE_DPAD) ? NSGAMEPAD_DPAD_CENTERED : 0x80;
+    }
+    // Sources in order, so the first one not at rest wins a PRIORITY field
+    // and a later one only replaces an ANY axis further from center
+    for (uint8_t s = 0; s < sources; s++) {
+        const uint8_t *v = values[s];
+        if (policies[NSMERGE_BUTTONS] == NSMERGE_PRIORITY && bits == 0) {
+            both |= source_pressed[s] & source_released[s];
+            bits = source_buttons[s];
+        }
+        source_pressed[s] = source_released[s] = 0;
+        uint8_t d = v[NSMERGE_DPAD] & 0x0F;
+        if (policies[NSMERGE_DPAD] == NSMERGE_ANY) {
+            x += dpad_x[d];
+            y += dpad_y[d];
+        }
+        else if (out[NSMERGE_DPAD] == NSGAMEPAD_DPAD_CENTERED) {
+            out[NSMERGE_DPAD] = v[NSMERGE_DPAD];
+        }
+        for (int i = NSMERGE_LEFT_X; i <= NSMERGE_RIGHT_Y; i++) {
+            int deflection = abs((int)v[i] - 0x80);
+            if (deflection == 0) continue;
+            if ((policies[i] == NSMERGE_ANY && deflection > abs((int)out[i] - 0x80)) ||
+                    out[i] == 0x80) {
+                out[i] = v[i];
+            }
+        }
+    }
+    if (policies[NSMERGE_DPAD] == NSMERGE_ANY) {
+        out[NSMERGE_DPAD] = dpad_of[sign(y) + 1][sign(x) + 1];
+    }
+
+    // A button that went both ways since the last update but ends where it
+    // was is handed over as two changes, so neither is lost
+    uint16_t blips = both & ~(bits ^ merged_buttons);
+    uint16_t tapped = blips & ~merged_buttons;
+    uint16_t repressed = blips & merged_buttons;
+    went_down = went_up = 0;
+    if (blips) {
+        NSGamepad.applyChanges(tapped, repressed, out, 0);
+    }
+    uint16_t press = (bits & ~merged_buttons) | repressed;
+    uint16_t release = (merged_buttons & ~bits) | tapped;
+    uint8_t mask = 0;
+    for (int i = NSMERGE_DPAD; i <= NSMERGE_RIGHT_Y; i++) {
+        if (out[i] != merged[i]) mask |= 1 << i;
+    }
+    merged_buttons = bits;
+    memcpy(merged, out, sizeof(merged));
+    if (press | release | mask) {
+        NSGamepad.applyChanges(press, release, out, mask);
+    }
+}
+
+#endif // NSGAMEPAD_INTERFACE
@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSGamepadMerge_h_
+#define NSGamepadMerge_h_
+
+#include <Arduino.h>
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// Sources one merge can combine
+#define NSMERGE_SOURCES 8
+// Fields, the report byte each one is in
+#define NSMERGE_BUTTONS 0
+#define NSMERGE_DPAD 2
+#define NSMERGE_LEFT_X 3
+#define NSMERGE_LEFT_Y 4
+#define NSMERGE_RIGHT_X 5
+#define NSMERGE_RIGHT_Y 6
+// Policies.  ANY presses a button while any source holds it, takes the
+// axis value furthest from center and adds up the dPad directions, so
+// opposite directions cancel.  PRIORITY takes the field from the first
+// source, in source order, that is not at rest.
+#define NSMERGE_ANY 0
+#define NSMERGE_PRIORITY 1
+
+// Combines several controllers into one NSGamepad.  Each source keeps its
+// own buttons, dPad and axes, set with applyChanges() the same way as
+// NSGamepad.applyChanges(), so a release from one source cannot cancel a
+// hold on another.  Each button counts the sources holding it, so with
+// NSMERGE_ANY the combined buttons are known without going over the
+// sources.  Setting a source only stores it.  update() combines the other
+// fields with the field's policy, one pass over the sources, and hands
+// NSGamepad the difference from its last result as a single change.  The
+// presses and releases since the last update() are kept as well, so a
+// button pressed and released again between two updates is handed over as
+// a press and a release, and one released and pressed again as a release
+// and a press.  Buttons and fields that no source changes are left to the
+// rest of the sketch.
+class NSGamepadMerge
+{
+    public:
+        NSGamepadMerge() : sources(0), dirty(false), held(0), went_down(0),
+            went_up(0) { };
+        // count sources, all at rest, and every policy NSMERGE_ANY
+        void begin(uint8_t count);
+        void policy(uint8_t field, uint8_t policy);
+        // Presses and releases the source's buttons and copies the report
+        // bytes in mask, as NSGamepad.applyChanges() does
+        void applyChanges(uint8_t source, uint16_t press, uint16_t release,
+                const void *report, uint8_t mask);
+        // Puts the source at rest, for a controller that went away
+        void clear(uint8_t source);
+        // Combines the sources into NSGamepad if any changed.  Call once
+        // per loop().
+        void update(void);
+        // Combined buttons and report bytes of the last update()
+        uint16_t buttons(void) { return merged_buttons; };
+        uint8_t value(uint8_t field) { return merged[field]; };
+    private:
+        void hold(uint16_t buttons);
+        void drop(uint16_t buttons);
+        uint8_t sources;
+        bool dirty;
+        uint8_t policies[NSGAMEPAD_REPORT_SIZE];
+        uint16_t source_buttons[NSMERGE_SOURCES];
+        uint8_t values[NSMERGE_SOURCES][NSGAMEPAD_REPORT_SIZE];
+        uint8_t holders[16];                    // sources holding each button
+        uint16_t held;                          // buttons with any holder
+        // Transitions since the last update(), of each source and of held
+        uint16_t source_pressed[NSMERGE_SOURCES];
+        uint16_t source_released[NSMERGE_SOURCES];
+        uint16_t went_down, went_up;
+        uint16_t merged_buttons;
+        uint8_t merged[NSGAMEPAD_REPORT_SIZE];
+};
+
+#endif // NSGAMEPAD_INTERFACE
+
+#endif // NSGamepadMerge_h_
@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSPinScan.h"
+
+// Edge timestamps
+#if defined(KINETISL)
+#define TIMESTAMP() micros()
+#define TIMESTAMP_PER_USEC 1
+#elif defined(KINETISK)
+#define TIMESTAMP() ARM_DWT_CYCCNT
+#define TIMESTAMP_PER_USEC (F_CPU / 1000000)
+#else
+#define TIMESTAMP() ARM_DWT_CYCCNT
+#define TIMESTAMP_PER_USEC (F_CPU_ACTUAL / 1000000)
+#endif
+
+// The scanner using pin change interrupts
+static NSPinScan *isr_scan = NULL;
+
+// Input register and bit of a pin
+static void pin_register(uint8_t pin, volatile uint32_t **reg, uint8_t *bit)
+{
+#if defined(KINETISK)
+    // Teensy 3.x gives a bit band alias of the pin's bit in GPIOx_PDIR
+    uint32_t alias = (uint32_t)portInputRegister(pin) - 0x42000000;
+    *reg = (volatile uint32_t *)(0x40000000 + ((alias >> 5) & ~3));
+    *bit = (alias >> 2) & 31;
+#else
+    // Teensy LC gives the byte of GPIOx_PDIR holding the pin and an 8 bit
+    // mask, read the whole aligned word instead. Teensy 4 registers are
+    // words already.
+    uintptr_t addr = (uintptr_t)portInputRegister(pin);
+    *reg = (volatile uint32_t *)(addr & ~3);
+    *bit = (addr & 3) * 8 + __builtin_ctz(digitalPinToBitMask(pin));
+#endif
+}
+
+uint8_t NSPinScan::attach(const uint8_t *pin_list, uint8_t count, uint8_t mode)
+{
+    uint8_t first = pins;
+    for (uint8_t i = 0; i < count && pins < NSSCAN_PINS; i++) {
+        volatile uint32_t *reg;
+        uint8_t bit, p;
+        pinMode(pin_list[i], mode);
+        pin_register(pin_list[i], &reg, &bit);
+        for (p = 0; p < ports && port_reg[p] != reg; p++) ;
+        if (p == NSSCAN_PORTS) continue;
+        if (p == ports) port_reg[ports++] = reg;
+        pin_number[pins] = pin_list[i];
+        pin_port[pins] = p;
+        pin_bit[pins] = bit;
+        if (mode == INPUT_PULLUP) invert |= (uint32_t)1 << pins;
+        pins++;
+    }
+    // start from the pins as they are
+    state = scan();
+    count0 = count1 = changes = 0;
+    last_scan = micros();
+    return first;
+}
+
+uint32_t NSPinScan::scan(void)
+{
+    uint32_t port[NSSCAN_PORTS];
+    for (uint8_t p = 0; p < ports; p++) port[p] = *port_reg[p];
+    uint32_t bits = 0;
+    for (uint8_t i = 0; i < pins; i++) {
+        bits |= ((port[pin_port[i]] >> pin_bit[i]) & 1) << i;
+    }
+    return bits ^ invert;
+}
+
+bool NSPinScan::update(void)
+{
+    changes = 0;
+    if (interrupts) return drain();
+    uint32_t now = micros();
+    if (now - last_scan < period) {
+        if (eager_mask == 0) return false;
+        take_eager(scan(), now, 1);
+        return changes != 0;
+    }
+    last_scan = now;
+
+    // Vertical counters: pins that read the same as their state reset
+    // their count, the others count up and toggle when it wraps to 0.
+    uint32_t bits = scan();
+    uint32_t delta = (bits ^ state) & ~eager_mask;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+    changes = delta & ~(count0 | count1);
+    state ^= changes;
+    if (eager_mask) take_eager(bits, now, 1);
+    return changes != 0;
+}
+
+void NSPinScan::eager(uint32_t pin_mask, uint16_t lockout_msec)
+{
+    if (lockout_msec > 1000) lockout_msec = 1000;
+    for (uint8_t i = 0; i < pins; i++) {
+        uint32_t bit = (uint32_t)1 << i;
+        if (!(pin_mask & bit)) continue;
+        lockout[i] = (uint32_t)lockout_msec * 1000;
+        if (lockout_msec) eager_mask |= bit;
+        else eager_mask &= ~bit;
+        locked &= ~bit;
+    }
+}
+
+// Eager pins that differ from their state and are out of lockout change
+// now and start a new lockout.  scale converts microseconds to now's units.
+void NSPinScan::take_eager(uint32_t bits, uint32_t now, uint32_t scale)
+{
+    for (uint32_t l = locked; l; l &= l - 1) {
+        uint8_t i = __builtin_ctz(l);
+        if (now - lock_start[i] >= lockout[i] * scale) locked &= ~((uint32_t)1 << i);
+    }
+    uint32_t edges = (bits ^ state) & eager_mask & ~locked;
+    for (uint32_t e = edges; e; e &= e - 1) lock_start[__builtin_ctz(e)] = now;
+    locked |= edges;
+    state ^= edges;
+    changes ^= edges;
+}
+
+void NSPinScan::useInterrupts(bool enable)
+{
+    for (uint8_t i = 0; i < pins; i++) {
+        detachInterrupt(digitalPinToInterrupt(pin_number[i]));
+    }
+    interrupts = false;
+    if (isr_scan == this) isr_scan = NULL;
+    locked = 0;
+    if (!enable || (isr_scan && isr_scan != this)) return;
+
+#if defined(KINETISK)
+    // Teensy 3 leaves the cycle counter off until something turns it on
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+    head = tail = 0;
+    resync = false;
+    isr_pins = raw = scan();
+    uint32_t settled = TIMESTAMP() - period * TIMESTAMP_PER_USEC * 4;
+    for (uint8_t i = 0; i < pins; i++) edge_time[i] = settled;
+    isr_scan = this;
+    interrupts = true;
+    for (uint8_t i = 0; i < pins; i++) {
+        attachInterrupt(digitalPinToInterrupt(pin_number[i]), pin_isr, CHANGE);
+    }
+}
+
+// Producer side of the ring, the only writer of head and isr_pins
+void NSPinScan::pin_isr(void)
+{
+    NSPinScan *s = isr_scan;
+    if (s == NULL) return;
+    uint32_t now = TIMESTAMP();
+    uint32_t bits = s->scan();
+    if (bits == s->isr_pins) return;
+    uint8_t h = s->head;
+    if ((uint8_t)(h - s->tail) >= NSSCAN_EVENTS) {
+        s->dropped++;
+        s->resync = true;
+        return;
+    }
+    s->isr_pins = bits;
+    NSPinEvent *e = &s->events[h & (NSSCAN_EVENTS - 1)];
+    e->time = now;
+    e->pins = bits;
+    __asm__ volatile("" ::: "memory");
+    s->head = h + 1;
+}
+
+// Consumer side of the ring, the only writer of tail
+bool NSPinScan::drain(void)
+{
+    uint8_t t = tail;
+    while (t != head) {
+        __asm__ volatile("" ::: "memory");
+        const NSPinEvent *e = &events[t & (NSSCAN_EVENTS - 1)];
+        for (uint32_t edges = e->pins ^ raw; edges; edges &= edges - 1) {
+            edge_time[__builtin_ctz(edges)] = e->time;
+        }
+        raw = e->pins;
+        if (eager_mask) take_eager(raw, e->time, TIMESTAMP_PER_USEC);
+        tail = ++t;
+    }
+    uint32_t now = TIMESTAMP();
+    if (resync) {
+        // edges were lost, start over from the pins as they are now
+        resync = false;
+        uint32_t bits = scan();
+        for (uint32_t edges = bits ^ raw; edges; edges &= edges - 1) {
+            edge_time[__builtin_ctz(edges)] = now;
+        }
+        raw = bits;
+    }
+    // eager pins whose lockout ended with a different level
+    if (eager_mask) take_eager(raw, now, TIMESTAMP_PER_USEC);
+
+    uint32_t hold = period * 4 * TIMESTAMP_PER_USEC;
+    uint32_t held = 0;
+    for (uint32_t pending = (raw ^ state) & ~eager_mask; pending; pending &= pending - 1) {
+        uint8_t i = __builtin_ctz(pending);
+        if (now - edge_time[i] >= hold) held |= (uint32_t)1 << i;
+    }
+    state ^= held;
+    changes |= held;
+    return changes != 0;
+}
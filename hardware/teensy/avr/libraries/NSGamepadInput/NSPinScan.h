@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSPinScan_h_
+#define NSPinScan_h_
+
+#include <Arduino.h>
+
+// Pins one scanner can read, one bit each
+#define NSSCAN_PINS 32
+// GPIO ports the pins can be spread over
+#define NSSCAN_PORTS 5
+// Edges the pin change interrupt can queue between updates, a power of 2
+#ifndef NSSCAN_EVENTS
+#define NSSCAN_EVENTS 16
+#endif
+
+// An edge captured by the pin change interrupt
+typedef struct {
+    uint32_t time;          // cycle counter, micros() on Teensy LC
+    uint32_t pins;          // all pins after the edge, 1 for pressed
+} NSPinEvent;
+
+// Reads and debounces up to 32 button pins at once.  attach() finds the
+// GPIO port register and bit of each pin, so a scan is one read of each
+// port the pins are on, gathered into a word with bit n for the nth pin
+// attached.  The pins are debounced together with vertical counters, a two
+// bit counter per pin kept in two words: a pin changes once it has read
+// differently 4 scans in a row, and the whole update is a few logic
+// operations on those words instead of a digitalRead() and timer per pin.
+//
+// With useInterrupts() the pins raise pin change interrupts instead.  Each
+// edge is captured with its time into a single producer, single consumer
+// ring, and update() drains it: a pin changes once it has held its new
+// level for the interval since its last edge.  update() can then run from
+// NSGamepad.setHandleReportBuild(), so presses reach the host however long
+// loop() takes.  One scanner can use interrupts.
+//
+// Pins set with eager() skip the wait: the first edge is reported at once,
+// then the pin ignores its edges for a lockout time, after which it takes
+// whatever level it has.  A press reaches the host one scan or one edge
+// after the contact closes, at the cost of reporting any glitch longer
+// than a scan as a press.
+class NSPinScan
+{
+    public:
+        NSPinScan() : pins(0), ports(0), invert(0), state(0), count0(0),
+            count1(0), changes(0), period(2500), eager_mask(0), locked(0),
+            interrupts(false) { };
+        // Adds pins at the next bits, returns the bit of the first one.  With
+        // INPUT_PULLUP a pin reads pressed when low, otherwise when high.
+        uint8_t attach(const uint8_t *pin_list, uint8_t count, uint8_t mode = INPUT_PULLUP);
+        // Time a pin must hold a new level, milliseconds.  Scans run every
+        // quarter of it.
+        void interval(uint16_t msec) { period = (uint32_t)msec * 250; };
+        // Scans when one is due, or takes the captured edges.  Returns true
+        // when a debounced pin changed.
+        bool update(void);
+        // Reports the first edge of the pins in the mask at once and ignores
+        // their edges for lockout milliseconds after, at most 1000.  Zero
+        // returns them to the interval.  The pins are read on every update().
+        void eager(uint32_t pin_mask, uint16_t lockout_msec);
+        // Captures edges with pin change interrupts instead of scanning.
+        // Call after attach().
+        void useInterrupts(bool enable);
+        // Edges that found the ring full.  The pins are then read again.
+        uint32_t droppedCount(void) { return dropped; };
+        // Debounced pins, 1 for pressed
+        uint32_t read(void) { return state; };
+        // Pins that were pressed or released by the last update()
+        uint32_t pressed(void) { return changes & state; };
+        uint32_t released(void) { return changes & ~state; };
+        // Reads the pins now, without debouncing
+        uint32_t scan(void);
+    private:
+        static void pin_isr(void);
+        bool drain(void);
+        void take_eager(uint32_t bits, uint32_t now, uint32_t scale);
+        uint8_t pins, ports;
+        uint8_t pin_number[NSSCAN_PINS];
+        volatile uint32_t *port_reg[NSSCAN_PORTS];
+        uint8_t pin_port[NSSCAN_PINS];
+        uint8_t pin_bit[NSSCAN_PINS];
+        uint32_t invert;
+        uint32_t state, count0, count1, changes;
+        uint32_t period, last_scan;
+        // eager pins, times in micros() or the interrupt time stamp
+        uint32_t eager_mask, locked;
+        uint32_t lockout[NSSCAN_PINS];          // microseconds
+        uint32_t lock_start[NSSCAN_PINS];
+        // interrupt mode
+        bool interrupts;
+        uint32_t raw;                           // pins after the last edge taken
+        uint32_t edge_time[NSSCAN_PINS];
+        NSPinEvent events[NSSCAN_EVENTS];
+        volatile uint8_t head, tail;            // written by the interrupt, by update()
+        volatile bool resync;
+        volatile uint32_t dropped;
+        uint32_t isr_pins;                      // pins after the last edge captured
+};
+
+#endif // NSPinScan_h_
@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSStick.h"
+
+// Full deflection, 8 bits of fraction
+#define FULL (128L << 8)
+
+// 1 / sqrt(n) with 22 bits of fraction for n = 16384, 16640 ... 65536
+static const uint16_t rsqrt_table[193] = {
+    32768, 32515, 32268, 32026, 31790, 31558, 31332, 31111, 30894, 30682,
+    30474, 30270, 30070, 29874, 29682, 29494, 29309, 29127, 28949, 28774,
+    28602, 28434, 28268, 28105, 27945, 27787, 27632, 27480, 27330, 27183,
+    27038, 26895, 26755, 26617, 26481, 26346, 26214, 26084, 25956, 25830,
+    25705, 25583, 25462, 25342, 25225, 25109, 24994, 24882, 24770, 24660,
+    24552, 24445, 24339, 24235, 24132, 24031, 23930, 23831, 23733, 23637,
+    23541, 23447, 23354, 23262, 23170, 23080, 22992, 22904, 22817, 22731,
+    22646, 22562, 22479, 22396, 22315, 22235, 22155, 22077, 21999, 21922,
+    21845, 21770, 21695, 21621, 21548, 21476, 21404, 21333, 21263, 21193,
+    21124, 21056, 20988, 20921, 20855, 20789, 20724, 20660, 20596, 20533,
+    20470, 20408, 20346, 20285, 20225, 20165, 20106, 20047, 19988, 19930,
+    19873, 19816, 19760, 19704, 19649, 19594, 19539, 19485, 19431, 19378,
+    19326, 19273, 19221, 19170, 19119, 19068, 19018, 18968, 18919, 18870,
+    18821, 18773, 18725, 18677, 18630, 18583, 18536, 18490, 18444, 18399,
+    18354, 18309, 18264, 18220, 18176, 18133, 18090, 18047, 18004, 17962,
+    17920, 17878, 17837, 17795, 17755, 17714, 17674, 17634, 17594, 17554,
+    17515, 17476, 17438, 17399, 17361, 17323, 17285, 17248, 17211, 17174,
+    17137, 17100, 17064, 17028, 16992, 16957, 16921, 16886, 16851, 16817,
+    16782, 16748, 16714, 16680, 16646, 16613, 16579, 16546, 16514, 16481,
+    16448, 16416, 16384,
+};
+
+void NSStick::begin(const NSStickShape &shape)
+{
+    square = shape.square;
+    uint8_t outer = (shape.outer && shape.outer <= 100) ? shape.outer : 100;
+    int32_t dead = (int32_t)shape.deadzone * FULL / 100;
+    int32_t edge = (int32_t)outer * FULL / 100;
+    for (int32_t i = 0; i <= NSSTICK_RADII; i++) {
+        int32_t m = i << 8;
+        int32_t r;
+        if (m <= dead) r = 0;
+        else if (edge <= dead || m >= edge) r = FULL;
+        else r = (int32_t)((int64_t)(m - dead) * FULL / (edge - dead));
+        radius[i] = r;
+    }
+}
+
+void NSStick::apply(uint8_t &x, uint8_t &y) const
+{
+    int32_t dx = x - 128;
+    int32_t dy = y - 128;
+    uint32_t r2 = dx * dx + dy * dy;
+    if (r2 == 0) return;
+
+    // Normalize r2 by an even power of 2 to 2^14 <= n < 2^16, look up
+    // 1 / sqrt(n) and undo the normalization with the shift below.
+    int s = (31 - __builtin_clz(r2)) & ~1;
+    uint32_t n = r2 << (14 - s);
+    uint32_t i = (n >> 8) - 64;
+    uint32_t rs = rsqrt_table[i] - (((rsqrt_table[i] - rsqrt_table[i + 1]) * (n & 0xFF)) >> 8);
+    int shift = 7 + s / 2;
+
+    // Input radius, 8 bits of fraction.  A square gate measures the radius
+    // to the square, so its edge is full deflection in every direction.
+    uint32_t m;
+    if (square) {
+        uint32_t ax = (dx < 0) ? -dx : dx;
+        uint32_t ay = (dy < 0) ? -dy : dy;
+        m = ((ax > ay) ? ax : ay) << 8;
+    }
+    else {
+        m = (r2 * rs) >> shift;
+    }
+    uint32_t k = m >> 8;
+    if (k >= NSSTICK_RADII) k = NSSTICK_RADII - 1;
+    int32_t r = radius[k] + ((((int32_t)radius[k + 1] - radius[k]) * (int32_t)(m & 0xFF)) >> 8);
+
+    // output radius / input radius, 16 bits of fraction
+    int32_t gain = ((uint32_t)r * rs) >> shift;
+    int32_t ox = 128 + ((dx * gain + 0x8000) >> 16);
+    int32_t oy = 128 + ((dy * gain + 0x8000) >> 16);
+    x = (ox < 0) ? 0 : (ox > 255) ? 255 : ox;
+    y = (oy < 0) ? 0 : (oy > 255) ? 255 : oy;
+}
@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NSStick_h_
+#define NSStick_h_
+
+#include <Arduino.h>
+
+// Largest stick radius the response table covers, the corner of the square
+// of 8 bit axis values is 181 from the center
+#define NSSTICK_RADII 182
+
+// Two axis response of one stick
+typedef struct {
+    uint8_t deadzone;       // percent of full deflection around the center, in any direction
+    uint8_t outer;          // percent of full deflection that reads as full, 0 for 100
+    // The stick has a square gate.  Full deflection in any direction,
+    // corners included, is mapped to the edge of the circle.  Without it
+    // deflection past full is clamped to the circle.
+    bool square;
+} NSStickShape;
+
+// Shapes an X/Y pair of NS axis values together.  The deadzone is a circle
+// instead of the cross that deadzones on each axis make, so a worn stick
+// resting off center in any direction reads as centered, and the direction
+// of the stick is kept while its radius is rescaled.  begin() bakes the
+// radius response into a table.  apply() finds the radius from a reciprocal
+// square root table and costs a handful of multiplies, with no floating
+// point, division or sqrt.
+class NSStick
+{
+    public:
+        void begin(const NSStickShape &shape);
+        // x and y are NS axis values, 128 centered
+        void apply(uint8_t &x, uint8_t &y) const;
+    private:
+        bool square;
+        // output radius for each input radius, 8 bits of fraction
+        uint16_t radius[NSSTICK_RADII + 1];
+};
+
+#endif // NSStick_h_
@@ -0,0 +1,267 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSGamepadMap.h"
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// Report byte that takes the writes of unmapped axes
+#define SCRATCH NSGAMEPAD_REPORT_SIZE
+
+// Hat switch value to dPad.  0 to 7 are directions, anything else centered.
+static const uint8_t hat_dpad[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7,
+    NSGAMEPAD_DPAD_CENTERED, NSGAMEPAD_DPAD_CENTERED,
+    NSGAMEPAD_DPAD_CENTERED, NSGAMEPAD_DPAD_CENTERED,
+    NSGAMEPAD_DPAD_CENTERED, NSGAMEPAD_DPAD_CENTERED,
+    NSGAMEPAD_DPAD_CENTERED, NSGAMEPAD_DPAD_CENTERED
+};
+
+// Hat switch value to stick X and Y
+static const uint8_t hat_x[16] = {
+    128, 255, 255, 255, 128, 0, 0, 0,
+    128, 128, 128, 128, 128, 128, 128, 128
+};
+static const uint8_t hat_y[16] = {
+    0, 0, 128, 255, 255, 255, 128, 0,
+    128, 128, 128, 128, 128, 128, 128, 128
+};
+
+bool NSGamepadMap::begin(const NSMapProfile *profiles, uint8_t count,
+        uint16_t idVendor, uint16_t idProduct, uint8_t instance)
+{
+    const NSMapProfile *p = NULL;
+
+    active = false;
+    inst = instance;
+    for (uint8_t i = 0; i < count; i++) {
+        if (profiles[i].idVendor != idVendor || profiles[i].idProduct != idProduct) continue;
+        p = &profiles[i];
+        if (instance-- == 0) break;
+    }
+    if (p == NULL) return false;
+    vid = idVendor;
+    pid = idProduct;
+
+    buttons.begin(p->buttons, p->buttonCount);
+
+    axis_used = 0;
+    memset(axis_curve, 0, sizeof(axis_curve));
+    memset(axis_byte, SCRATCH, sizeof(axis_byte));
+    uint8_t curve = 0;
+    for (uint8_t i = 0; i < p->axisCount && curve < NSMAP_CURVES; i++) {
+        const NSMapAxis *a = &p->axes[i];
+        if (a->axis >= NSMAP_AXES || a->axis == p->hatAxis) continue;
+        if (a->shape) {
+            curves[curve].begin(*a->shape);
+        }
+        else {
+            curves[curve].begin(a->maximum ? a->maximum : 255);
+        }
+        axis_curve[a->axis] = curve++;
+        axis_byte[a->axis] = a->target;
+        axis_used |= (uint64_t)1 << a->axis;
+    }
+
+    stick_used = 0;
+    const NSStickShape *stick[2] = {p->leftStick, p->rightStick};
+    for (int i = 0; i < 2; i++) {
+        if (stick[i] == NULL) continue;
+        sticks[i].begin(*stick[i]);
+        stick_used |= 1 << i;
+    }
+
+    hat_bit = 0;
+    hat_axis = p->hatAxis;
+    if (hat_axis < NSMAP_AXES) {
+        hat_bit = (uint64_t)1 << hat_axis;
+        if (p->hatTarget == NSMAP_DPAD) {
+            hat_byte[0] = NSMAP_DPAD;
+            hat_byte[1] = SCRATCH;
+            hat_value[0] = hat_value[1] = hat_dpad;
+        }
+        else {
+            hat_byte[0] = p->hatTarget;
+            hat_byte[1] = p->hatTarget + 1;
+            hat_value[0] = hat_x;
+            hat_value[1] = hat_y;
+        }
+    }
+
+    bits_old = 0;
+    joystick_buttons = 0;
+    dropped = 0;
+    memset(axis_value, 0, sizeof(axis_value));
+    fields_set = 0;
+    first_report = true;
+    memset(raw, 0x80, sizeof(raw));
+    memcpy(routed, raw, sizeof(routed));
+    memcpy(out, routed, sizeof(out));
+    active = true;
+    return true;
+}
+
+void NSGamepadMap::update(JoystickController &joystick)
+{
+    update(joystick, joystick.axisChangedMask());
+}
+
+void NSGamepadMap::update(JoystickController &joystick, uint64_t changed_axes)
+{
+    if (!active) return;
+
+    // The first report takes every axis, a value equal to the initial 0
+    // does not show up as a change.
+    uint64_t axes = first_report ? joystick.axisMask() : changed_axes;
+    first_report = false;
+    for (uint64_t a = axes & (axis_used | hat_bit); a; a &= a - 1) {
+        int i = __builtin_ctzll(a);
+        axis_value[i] = joystick.getAxis(i);
+    }
+    apply(joystick.getButtons(), axes);
+}
+
+void NSGamepadMap::updateEvents(JoystickController &joystick)
+{
+    JoystickController::event_t e;
+
+    if (!active) {
+        while (joystick.readEvent(e)) { }
+        return;
+    }
+    // Start from the latest values when the queue missed changes, what it
+    // still holds is older
+    if (first_report || joystick.droppedEvents() != dropped) {
+        dropped = joystick.droppedEvents();
+        while (joystick.readEvent(e)) { }
+        update(joystick, joystick.axisMask());
+        return;
+    }
+
+    // Each button change starts a new change to the report, so a press and
+    // release read together still reach NSGamepad as two
+    uint32_t bits = joystick_buttons;
+    uint64_t axes = 0;
+    bool pending = false;
+    while (joystick.readEvent(e)) {
+#if NSGAMEPAD_LATENCY_HISTOGRAM
+        NSGamepad.stampInput(e.time);
+#endif
+        if (e.axis == JoystickController::EVENT_BUTTONS) {
+            if (pending) apply(bits, axes);
+            bits = e.value;
+            axes = 0;
+        }
+        else if (e.axis < NSMAP_AXES) {
+            axis_value[e.axis] = e.value;
+            axes |= (uint64_t)1 << e.axis;
+        }
+        pending = true;
+    }
+    if (pending) apply(bits, axes);
+}
+
+void NSGamepadMap::apply(uint32_t joystick_bits, uint64_t axes)
+{
+    joystick_buttons = joystick_bits;
+    uint32_t bits = buttons.remap(joystick_bits);
+    uint32_t press = bits & ~bits_old;
+    uint32_t release = bits_old & ~bits;
+    uint16_t fields = 0;
+    if (buttons.hasDPad() && ((press | release) >> 16)) {
+        out[NSMAP_DPAD] = NSButtonRemap::dPad(bits);
+        fields |= 1 << NSMAP_DPAD;
+    }
+    bits_old = bits;
+
+    uint16_t moved = 0;                 // bytes the axes and sticks wrote
+    for (uint64_t changed = axes & axis_used; changed; changed &= changed - 1) {
+        int i = __builtin_ctzll(changed);
+        uint8_t b = axis_byte[i];
+        out[b] = routed[b] = raw[b] = curves[axis_curve[i]].apply(axis_value[i]);
+        moved |= 1 << b;
+    }
+    fields |= moved;
+
+    // Sticks take both axes when either one moved
+    for (int i = 0; i < 2; i++) {
+        uint8_t b = NSMAP_LEFT_X + 2 * i;
+        if (!((stick_used >> i) & 1) || !((fields >> b) & 3)) continue;
+        uint8_t x = raw[b], y = raw[b + 1];
+        sticks[i].apply(x, y);
+        out[b] = routed[b] = x;
+        out[b + 1] = routed[b + 1] = y;
+        fields |= 3 << b;
+        moved |= 3 << b;
+    }
+
+    // The hat shows through its target bytes while their own axes are
+    // centered, so it is laid over again when either of them moved too
+    if (hat_bit) {
+        uint16_t targets = ((1 << hat_byte[0]) | (1 << hat_byte[1])) & ~(1 << SCRATCH);
+        if ((axes & hat_bit) || (moved & targets)) {
+            uint32_t v = axis_value[hat_axis] & 0x0F;
+            for (int i = 0; i < 2; i++) {
+                uint8_t b = hat_byte[i];
+                out[b] = (routed[b] == 0x80) ? hat_value[i][v] : routed[b];
+                fields |= 1 << b;
+            }
+        }
+    }
+
+    fields_set |= fields;
+    if (press | release | (uint8_t)fields) {
+        send(press, release, fields);
+    }
+}
+
+void NSGamepadMap::send(uint16_t press, uint16_t release, uint8_t mask)
+{
+    if (merge) {
+        merge->applyChanges(merge_source, press, release, out, mask);
+    }
+    else {
+        NSGamepad.applyChanges(press, release, out, mask);
+    }
+}
+
+void NSGamepadMap::end(void)
+{
+    if (!active) return;
+    active = false;
+    if (merge) {
+        merge->clear(merge_source);
+        return;
+    }
+    uint16_t fields = fields_set & ((1 << NSGAMEPAD_REPORT_SIZE) - 1);
+    for (uint16_t f = fields; f; f &= f - 1) {
+        uint8_t b = __builtin_ctz(f);
+        out[b] = (b == NSMAP_DPAD) ? NSGAMEPAD_DPAD_CENTERED : 0x80;
+    }
+    if ((uint16_t)bits_old | fields) {
+        send(0, (uint16_t)bits_old, fields);
+    }
+}
+
+#endif // NSGAMEPAD_INTERFACE
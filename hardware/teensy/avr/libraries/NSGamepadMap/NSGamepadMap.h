@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Table driven mapping of USB host controllers to NSGamepad
+ *
+ * A profile describes one controller, found by the USB vendor and product
+ * IDs also used by JoystickController::pid_vid_mapping:
+ *
+ *   static const NSMapAxis T16K_AXES[] = {
+ *       {0, NSMAP_LEFT_X, 0x3FFF},      // big stick X, 14 bits
+ *       {1, NSMAP_LEFT_Y, 0x3FFF},
+ *       {5, NSMAP_RIGHT_X, 255},        // twist
+ *   };
+ *   static const NSMapProfile PROFILES[] = {
+ *       {0x044F, 0xB10A, T16K_BUTTONS, 16, T16K_AXES, 3, 9, NSMAP_RIGHT_STICK},
+ *   };
+ *
+ * begin() compiles the profile into flat tables indexed by controller button
+ * byte and axis number, with each axis shape baked into an NSAxisCurve.
+ * update() then remaps the buttons with one lookup per byte and makes one
+ * pass over the changed axes with one curve lookup each, no division and no
+ * branch on the axis number, runs the NSStick stage on sticks with a moved
+ * axis, and hands the result to NSGamepad as a single change.
+ *
+ * All state lives in the NSGamepadMap, so use one per JoystickController:
+ * identical controllers then keep their own button edges and axis values.
+ * end() takes back what the controller had set when it disconnects.  With
+ * mergeInto() several controllers go through an NSGamepadMerge instead.
+ */
+
+#ifndef NSGamepadMap_h_
+#define NSGamepadMap_h_
+
+#include <Arduino.h>
+#include <USBHost_t36.h>
+#include <NSButtonRemap.h>
+#include <NSAxisCurve.h>
+#include <NSStick.h>
+#include <NSGamepadMerge.h>
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+// Controller axes a profile can map, getAxis() 0 to NSMAP_AXES - 1
+#define NSMAP_AXES 16
+// Axes one profile can map, each with its own NSAxisCurve
+#define NSMAP_CURVES 6
+// Axis targets, the report byte each one sets
+#define NSMAP_LEFT_X 3
+#define NSMAP_LEFT_Y 4
+#define NSMAP_RIGHT_X 5
+#define NSMAP_RIGHT_Y 6
+// Hat switch targets.  On a stick the hat moves it fully in its direction,
+// except for an axis another axis of the profile is holding off center.
+#define NSMAP_DPAD 2
+#define NSMAP_LEFT_STICK NSMAP_LEFT_X
+#define NSMAP_RIGHT_STICK NSMAP_RIGHT_X
+
+typedef struct {
+    uint8_t axis;           // getAxis() index
+    uint8_t target;         // NSMAP_LEFT_X ... NSMAP_RIGHT_Y
+    uint16_t maximum;       // largest value the axis reports, 255 for 8 bits
+    // Range, deadzone and response curve, or NULL for linear from 0 to
+    // maximum.  The shape's input range replaces maximum.
+    const NSAxisShape *shape;
+} NSMapAxis;
+
+typedef struct {
+    uint16_t idVendor;
+    uint16_t idProduct;
+    // NS button or NSMAP_DPAD_* for each controller button, NSMAP_UNUSED to
+    // ignore one.  NULL passes buttons through with the same numbers.  See
+    // NSButtonRemap.
+    const uint8_t *buttons;
+    uint8_t buttonCount;
+    const NSMapAxis *axes;
+    uint8_t axisCount;
+    // hat switch axis or NSMAP_UNUSED, and NSMAP_DPAD, NSMAP_LEFT_STICK or
+    // NSMAP_RIGHT_STICK
+    uint8_t hatAxis;
+    uint8_t hatTarget;
+    // Radial deadzone and gate correction of each stick's X/Y pair, or NULL
+    // to leave the axes independent.  Give those axes linear shapes.
+    const NSStickShape *leftStick;
+    const NSStickShape *rightStick;
+} NSMapProfile;
+
+// Maps one controller to NSGamepad.  Use one per JoystickController.
+class NSGamepadMap
+{
+    public:
+        NSGamepadMap() : merge(NULL), active(false) { };
+        // Compiles the profile for the controller.  When several profiles
+        // have the same IDs, instance picks the second, third... one, for
+        // controllers that are used in pairs.  Returns false if no profile
+        // matches.
+        bool begin(const NSMapProfile *profiles, uint8_t count,
+                uint16_t idVendor, uint16_t idProduct, uint8_t instance = 0);
+        // Releases the buttons and centers the axes and dPad this controller
+        // set, for when it disconnects
+        void end(void);
+        operator bool() { return active; };
+        uint16_t idVendor(void) { return vid; };
+        uint16_t idProduct(void) { return pid; };
+        // The instance given to begin()
+        uint8_t instance(void) { return inst; };
+        // Maps the buttons and changed axes of the controller's latest
+        // input report into NSGamepad.  Call when joystick.available().
+        void update(JoystickController &joystick);
+        // The same for an attachEvent() function, or code that saved the
+        // changes, with the axes that changed since the last update()
+        void update(JoystickController &joystick, uint64_t changed_axes);
+        // Maps every change recorded in the controller's attachQueue()
+        // queue, in order, so a press and release between two calls are
+        // both seen.  Use instead of update().
+        void updateEvents(JoystickController &joystick);
+        // Sends the controller to a source of merge instead of straight
+        // to NSGamepad, NULL to go back
+        void mergeInto(NSGamepadMerge *merge, uint8_t source) {
+            this->merge = merge;
+            merge_source = source;
+        };
+    private:
+        void apply(uint32_t joystick_bits, uint64_t axes);
+        void send(uint16_t press, uint16_t release, uint8_t mask);
+        // compiled profile
+        NSButtonRemap buttons;
+        NSAxisCurve curves[NSMAP_CURVES];
+        NSStick sticks[2];
+        uint8_t stick_used;                     // bit for each stick with a shape
+        uint8_t axis_curve[NSMAP_AXES];         // index into curves
+        uint8_t axis_byte[NSMAP_AXES];          // report byte or SCRATCH
+        uint64_t axis_used;
+        uint64_t hat_bit;
+        uint8_t hat_axis;
+        uint8_t hat_byte[2];
+        const uint8_t *hat_value[2];
+        uint16_t vid, pid;
+        uint8_t inst;
+        NSGamepadMerge *merge;
+        uint8_t merge_source;
+        bool active;
+        // state
+        uint32_t bits_old;
+        uint32_t joystick_buttons;              // controller buttons before remapping
+        int32_t axis_value[NSMAP_AXES];         // controller axes
+        uint32_t dropped;                       // droppedEvents() already resynced
+        uint16_t fields_set;                    // bit for each report byte update() wrote
+        bool first_report;
+        uint8_t raw[NSGAMEPAD_REPORT_SIZE + 1];     // last curve output of each axis target
+        uint8_t routed[NSGAMEPAD_REPORT_SIZE + 1];  // the same after the stick stage
+        uint8_t out[NSGAMEPAD_REPORT_SIZE + 1];
+};
+
+#endif // NSGAMEPAD_INTERFACE
+
+#endif // NSGamepadMap_h_
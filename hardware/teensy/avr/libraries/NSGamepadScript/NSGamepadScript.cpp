@@ -0,0 +1,324 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "NSGamepadScript.h"
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+#if (NSSCRIPT_QUEUE_SIZE & (NSSCRIPT_QUEUE_SIZE - 1)) != 0
+#error "NSSCRIPT_QUEUE_SIZE must be a power of 2"
+#endif
+#if (NSSCRIPT_RECORD_SIZE & (NSSCRIPT_RECORD_SIZE - 1)) != 0
+#error "NSSCRIPT_RECORD_SIZE must be a power of 2"
+#endif
+
+// varint of 32 bits, mask and every report byte
+#define RECORD_MAX (5 + 1 + NSGAMEPAD_REPORT_SIZE)
+
+static const uint8_t neutral_report[NSGAMEPAD_REPORT_SIZE] = {
+    0x00, 0x00, NSGAMEPAD_DPAD_CENTERED, 0x80, 0x80, 0x80, 0x80, 0x00
+};
+
+int NSScriptMemory::read(uint8_t *buffer, int count)
+{
+    uint32_t left = length - position;
+    if ((uint32_t)count > left) count = left;
+    memcpy(buffer, data + position, count);
+    position += count;
+    return count;
+}
+
+NSScriptPlayer *NSScriptPlayer::playing_now = NULL;
+
+bool NSScriptPlayer::begin(NSScriptSource &script)
+{
+    end();
+    if (!usb_configuration) return false;
+    source = &script;
+    buffer_pos = buffer_len = 0;
+    source_done = false;
+    decode_done = false;
+    failed = false;
+    ticks = 0;
+    queue_head = queue_tail = 0;
+    current_frame = 0;
+    late = 0;
+    finished = false;
+
+    if (!read_header()) {
+        source = NULL;
+        return false;
+    }
+    interval_usec = usb_nsgamepad_interval_usec();
+
+    // frame 0 is applied here, later frames by the transmit interrupt
+    memcpy(_report, neutral_report, NSGAMEPAD_REPORT_SIZE);
+    task();
+    while (queue_tail != queue_head && queue[queue_tail].frame == 0) {
+        apply(&queue[queue_tail]);
+        queue_tail = (queue_tail + 1) & (NSSCRIPT_QUEUE_SIZE - 1);
+    }
+    usb_nsgamepad_commit();
+
+    saved_sof_sync = usb_nsgamepad_sof_sync_enabled();
+    playing_now = this;
+    active = true;
+    usb_nsgamepad_set_tx_callback(tx_complete);
+    usb_nsgamepad_sof_sync(1);
+    return true;
+}
+
+void NSScriptPlayer::end(void)
+{
+    if (!active) return;
+    usb_nsgamepad_set_tx_callback(NULL);
+    usb_nsgamepad_sof_sync(saved_sof_sync);
+    playing_now = NULL;
+    active = false;
+    source = NULL;
+}
+
+bool NSScriptPlayer::task(void)
+{
+    if (finished) end();
+    if (!source) return active;
+    // keep the queue full so the interrupt never waits for the script
+    while (!decode_done) {
+        uint32_t head = queue_head;
+        uint32_t next = (head + 1) & (NSSCRIPT_QUEUE_SIZE - 1);
+        if (next == queue_tail) break;
+        if (!decode(&queue[head])) {
+            decode_done = true;
+            break;
+        }
+        __asm__ volatile("" ::: "memory");
+        queue_head = next;
+    }
+    return active;
+}
+
+bool NSScriptPlayer::read_header(void)
+{
+    uint8_t header[NSSCRIPT_HEADER_SIZE];
+    for (int i = 0; i < NSSCRIPT_HEADER_SIZE; i++) {
+        int c = next_byte();
+        if (c < 0) return false;
+        header[i] = c;
+    }
+    if (memcmp(header, "NSGS", 4) != 0 || header[4] != NSSCRIPT_VERSION) {
+        return false;
+    }
+    for (int i = NSSCRIPT_HEADER_SIZE; i < header[5]; i++) {
+        if (next_byte() < 0) return false;
+    }
+    tick_usec = header[8] | (header[9] << 8) | (header[10] << 16) |
+        ((uint32_t)header[11] << 24);
+    return true;
+}
+
+int NSScriptPlayer::next_byte(void)
+{
+    if (buffer_pos >= buffer_len) {
+        if (source_done) return -1;
+        int n = source->read(buffer, NSSCRIPT_READ_SIZE);
+        if (n <= 0) {
+            if (n < 0) failed = true;
+            source_done = true;
+            return -1;
+        }
+        buffer_pos = 0;
+        buffer_len = n;
+    }
+    return buffer[buffer_pos++];
+}
+
+bool NSScriptPlayer::read_varint(uint32_t *value)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = next_byte();
+        if (c < 0) return false;
+        v |= (uint32_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0) {
+            *value = v;
+            return true;
+        }
+    }
+    failed = true;
+    return false;
+}
+
+// returns false at the end of the script
+bool NSScriptPlayer::decode(record_t *r)
+{
+    uint32_t delta;
+    if (!read_varint(&delta)) return false;
+    int c = next_byte();
+    if (c < 0) {
+        failed = true;
+        return false;
+    }
+    r->mask = c;
+    for (int i = 0; i < NSGAMEPAD_REPORT_SIZE; i++) {
+        if (r->mask & (1 << i)) {
+            c = next_byte();
+            if (c < 0) {
+                failed = true;
+                return false;
+            }
+            r->data[i] = c;
+        }
+    }
+    ticks += delta;
+    if (tick_usec == 0) {
+        r->frame = ticks;
+    } else {
+        r->frame = (ticks * tick_usec + interval_usec / 2) / interval_usec;
+    }
+    return true;
+}
+
+void NSScriptPlayer::apply(const record_t *r)
+{
+    uint8_t *report = (uint8_t *)_report;
+    for (int i = 0; i < NSGAMEPAD_REPORT_SIZE; i++) {
+        if (r->mask & (1 << i)) report[i] = r->data[i];
+    }
+}
+
+// called from the USB interrupt each time the host reads a report, to make
+// the report for the following poll
+void NSScriptPlayer::play_frame(void)
+{
+    uint32_t tail = queue_tail;
+    if (tail == queue_head && decode_done) {
+        // the host has read the last frame
+        finished = true;
+        return;
+    }
+    uint32_t frame = current_frame + 1;
+    bool changed = false;
+    while (tail != queue_head) {
+        const record_t *r = &queue[tail];
+        if ((int32_t)(r->frame - frame) > 0) break;
+        if (r->frame != frame) late++;
+        apply(r);
+        changed = true;
+        tail = (tail + 1) & (NSSCRIPT_QUEUE_SIZE - 1);
+    }
+    queue_tail = tail;
+    current_frame = frame;
+    if (changed) usb_nsgamepad_commit();
+}
+
+void NSScriptPlayer::tx_complete(void)
+{
+    if (playing_now) playing_now->play_frame();
+}
+
+NSScriptRecorder *NSScriptRecorder::recording_now = NULL;
+
+void NSScriptRecorder::begin(void)
+{
+    end();
+    static const uint8_t header[NSSCRIPT_HEADER_SIZE] = {
+        'N', 'S', 'G', 'S', NSSCRIPT_VERSION, NSSCRIPT_HEADER_SIZE, 0, 0,
+        1, 0, 0, 0      // ticks are microseconds
+    };
+    memcpy(ring, header, NSSCRIPT_HEADER_SIZE);
+    tail = 0;
+    head = NSSCRIPT_HEADER_SIZE;
+    memcpy(state, neutral_report, NSGAMEPAD_REPORT_SIZE);
+    dropped = 0;
+    last_usec = micros();
+    recording_now = this;
+    active = true;
+    usb_nsgamepad_set_sent_callback(report_sent);
+}
+
+void NSScriptRecorder::end(void)
+{
+    if (!active) return;
+    usb_nsgamepad_set_sent_callback(NULL);
+    recording_now = NULL;
+    active = false;
+}
+
+size_t NSScriptRecorder::drain(Print &out)
+{
+    size_t total = 0;
+    // at most two pieces, up to the end of the ring and from its start
+    for (int i = 0; i < 2; i++) {
+        uint32_t t = tail;
+        uint32_t count = head - t;
+        uint32_t offset = t & (NSSCRIPT_RECORD_SIZE - 1);
+        if (count > NSSCRIPT_RECORD_SIZE - offset) {
+            count = NSSCRIPT_RECORD_SIZE - offset;
+        }
+        if (count == 0) break;
+        size_t n = out.write(ring + offset, count);
+        tail = t + n;
+        total += n;
+        if (n < count) break;
+    }
+    return total;
+}
+
+// called from the USB interrupt with each report the host reads
+void NSScriptRecorder::record(const uint8_t *report)
+{
+    uint32_t now = micros();
+    uint32_t h = head;
+    if (NSSCRIPT_RECORD_SIZE - (h - tail) < RECORD_MAX) {
+        dropped++;
+        return;
+    }
+    uint32_t delta = now - last_usec;
+    last_usec = now;
+    do {
+        uint8_t b = delta & 0x7F;
+        delta >>= 7;
+        if (delta) b |= 0x80;
+        ring[h++ & (NSSCRIPT_RECORD_SIZE - 1)] = b;
+    } while (delta);
+    uint32_t mask_pos = h++;
+    uint8_t mask = 0;
+    for (int i = 0; i < NSGAMEPAD_REPORT_SIZE; i++) {
+        if (report[i] != state[i]) {
+            state[i] = report[i];
+            mask |= 1 << i;
+            ring[h++ & (NSSCRIPT_RECORD_SIZE - 1)] = report[i];
+        }
+    }
+    ring[mask_pos & (NSSCRIPT_RECORD_SIZE - 1)] = mask;
+    __asm__ volatile("" ::: "memory");
+    head = h;
+}
+
+void NSScriptRecorder::report_sent(const void *report)
+{
+    if (recording_now) recording_now->record((const uint8_t *)report);
+}
+
+#endif // NSGAMEPAD_INTERFACE
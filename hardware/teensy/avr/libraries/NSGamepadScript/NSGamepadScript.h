@@ -0,0 +1,218 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 gdsports625@gmail.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * NS gamepad script format
+ *
+ * A script is a 12 byte header followed by records, all little endian.
+ *
+ *   header  'N' 'S' 'G' 'S'   magic
+ *           uint8             version, 1
+ *           uint8             header length, 12.  Readers skip any extra bytes.
+ *           uint16            reserved, 0
+ *           uint32            tick length in microseconds, or 0 when ticks
+ *                             are host polls (USB frames of the NS gamepad
+ *                             endpoint)
+ *
+ *   record  varint            ticks since the previous record (the first
+ *                             record counts from tick 0)
+ *           uint8             mask, bit n set when report byte n changed
+ *           uint8[]           the changed report bytes, lowest first
+ *
+ * The varint holds 7 bits per byte, least significant group first, with
+ * bit 7 set on every byte except the last.  Report bytes are those of
+ * HID_NSGamepadReport_Data_t and start out neutral: no buttons, dPad
+ * centered, all axes 0x80.  A record with mask 0 changes nothing and can
+ * mark the end time of a script.  The script ends at the end of the data.
+ */
+
+#ifndef NSGamepadScript_h_
+#define NSGamepadScript_h_
+
+#include <Arduino.h>
+
+#if defined(NSGAMEPAD_INTERFACE)
+
+#define NSSCRIPT_VERSION 1
+#define NSSCRIPT_HEADER_SIZE 12
+
+// Decoded records waiting for their frame.  Must be a power of 2.
+#ifndef NSSCRIPT_QUEUE_SIZE
+#if defined(__MKL26Z64__)
+#define NSSCRIPT_QUEUE_SIZE 32
+#else
+#define NSSCRIPT_QUEUE_SIZE 512
+#endif
+#endif
+// RAM ring of recorded data waiting for NSScriptRecorder::drain().  Must be
+// a power of 2.
+#ifndef NSSCRIPT_RECORD_SIZE
+#if defined(__MKL26Z64__)
+#define NSSCRIPT_RECORD_SIZE 512
+#else
+#define NSSCRIPT_RECORD_SIZE 8192
+#endif
+#endif
+#ifndef NSSCRIPT_READ_SIZE
+#if defined(__MKL26Z64__)
+#define NSSCRIPT_READ_SIZE 64
+#else
+#define NSSCRIPT_READ_SIZE 512
+#endif
+#endif
+
+// Where a script is read from.  read() returns the number of bytes copied,
+// 0 at the end of the script or -1 on error.
+class NSScriptSource
+{
+    public:
+        virtual int read(uint8_t *buffer, int length) = 0;
+};
+
+// Script stored in memory or flash, for example
+// const uint8_t script[] PROGMEM = {...};
+class NSScriptMemory : public NSScriptSource
+{
+    public:
+        NSScriptMemory(const uint8_t *data, uint32_t length) :
+            data(data), length(length), position(0) { };
+        virtual int read(uint8_t *buffer, int count);
+    private:
+        const uint8_t *data;
+        uint32_t length;
+        uint32_t position;
+};
+
+// Script streamed from an open file, such as SD.open("soak.nsg").  Any
+// class with read(buffer, length) works.
+template <class FileType>
+class NSScriptFile : public NSScriptSource
+{
+    public:
+        NSScriptFile(FileType &file) : file(file) { };
+        virtual int read(uint8_t *buffer, int length) {
+            return file.read(buffer, length);
+        };
+    private:
+        FileType &file;
+};
+
+// Plays a script into NSGamepad, one record applied on the exact host poll
+// it names.  Frames are counted by the USB transmit complete interrupt, so
+// playback follows the host's clock and does not drift.  task() must be
+// called from loop() to read and decode the script ahead of playback; the
+// interrupt only takes decoded records from a queue.  While playing, the
+// player owns NSGamepad's report, start of frame sync and transmit complete
+// handler.
+class NSScriptPlayer
+{
+    public:
+        NSScriptPlayer() : source(NULL), late(0), failed(false), active(false) { };
+        // Reads the header and the records of frame 0 and starts playback.
+        // Returns false if the script is not valid or the USB is not
+        // configured.
+        bool begin(NSScriptSource &script);
+        void end(void);
+        // Call often from loop().  Returns true while playing.
+        bool task(void);
+        bool playing(void) { return active; };
+        // host polls since begin()
+        uint32_t frame(void) { return current_frame; };
+        // records applied after their frame because the queue ran empty
+        uint32_t lateCount(void) { return late; };
+        // true if the script ended with a read or format error
+        bool error(void) { return failed; };
+    private:
+        typedef struct {
+            uint32_t frame;
+            uint8_t mask;
+            uint8_t data[NSGAMEPAD_REPORT_SIZE];
+        } record_t;
+        bool read_header(void);
+        int next_byte(void);
+        bool read_varint(uint32_t *value);
+        bool decode(record_t *r);
+        void apply(const record_t *r);
+        void play_frame(void);
+        static void tx_complete(void);
+        static NSScriptPlayer *playing_now;
+
+        NSScriptSource *source;
+        uint8_t buffer[NSSCRIPT_READ_SIZE];
+        uint16_t buffer_pos, buffer_len;
+        bool source_done;
+        uint32_t tick_usec;
+        uint32_t interval_usec;
+        uint64_t ticks;
+        record_t queue[NSSCRIPT_QUEUE_SIZE];
+        volatile uint32_t queue_head;   // written by task()
+        volatile uint32_t queue_tail;   // written by the interrupt
+        volatile uint32_t current_frame;
+        volatile uint32_t late;
+        volatile bool finished;
+        volatile bool decode_done;
+        bool failed;
+        bool active;
+        bool saved_sof_sync;
+};
+
+// Records every report the host reads as a script with microsecond ticks,
+// counted from begin().  Each report costs one record of at most 14 bytes,
+// built from the USB interrupt in fixed time: the varint time since the
+// previous report, the mask and the bytes that changed.  drain() writes the
+// ring to an SD file or Serial from loop().  If the ring is full the report
+// is counted in droppedCount() and the next record covers the gap.  Replay a
+// recording with NSScriptPlayer or decode it with extras/nsscript/nsscript.py.
+class NSScriptRecorder
+{
+    public:
+        NSScriptRecorder() : dropped(0), active(false) { };
+        // Starts a new recording.  Data not yet drained is discarded.
+        void begin(void);
+        void end(void);
+        bool recording(void) { return active; };
+        // Writes the recorded bytes waiting in the ring to out, for example
+        // an SD file or Serial.  Returns the number of bytes written.
+        size_t drain(Print &out);
+        // bytes waiting to be drained
+        uint32_t available(void) { return head - tail; };
+        // reports not recorded because the ring was full
+        uint32_t droppedCount(void) { return dropped; };
+    private:
+        void record(const uint8_t *report);
+        static void report_sent(const void *report);
+        static NSScriptRecorder *recording_now;
+
+        uint8_t ring[NSSCRIPT_RECORD_SIZE];
+        volatile uint32_t head;     // written by the interrupt
+        volatile uint32_t tail;     // written by drain()
+        uint8_t state[NSGAMEPAD_REPORT_SIZE];
+        uint32_t last_usec;
+        volatile uint32_t dropped;
+        bool active;
+};
+
+#endif // NSGAMEPAD_INTERFACE
+
+#endif // NSGamepadScript_h_
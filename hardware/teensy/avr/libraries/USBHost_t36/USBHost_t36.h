@@ -915,6 +915,12 @@ public:
 	uint64_t axisChangedMask() { return axis_changed_mask_;}
 	uint64_t axisChangeNotifyMask() {return axis_change_notify_mask_;}
 	void 	 axisChangeNotifyMask(uint64_t notify_mask) {axis_change_notify_mask_ = notify_mask;}
+	// Called from the USB host interrupt for each input report that changed
+	// the buttons or a notify mask axis, with the axes it changed and the
+	// buttons it pressed and released.  The function takes the report, so
+	// available() stays false while one is attached.
+	void	 attachEvent(void (*f)(JoystickController &joystick, uint64_t changed_axes,
+				uint32_t pressed, uint32_t released)) {eventCallback = f;}
 
 	// set functions functionality depends on underlying joystick. 
     bool setRumble(uint8_t lValue, uint8_t rValue, uint8_t timeout=0xff);
@@ -925,6 +931,26 @@ public:
 	typedef enum { UNKNOWN=0, PS3, PS4, XBOXONE, XBOX360, PS3_MOTION, SpaceNav, HORIPAD, DRAGONRISE, EXTREME3D, T16000M} joytype_t;
 	joytype_t joystickType() {return joystickType_;} 
 
+	// One change captured by the event queue: all the buttons, or one axis
+	enum { EVENT_BUTTONS = 0xFF };
+	typedef struct {
+		uint32_t time;		// ARM_DWT_CYCCNT when the report was processed
+		uint8_t axis;		// getAxis() index, or EVENT_BUTTONS
+		int32_t value;		// the axis value, or getButtons()
+	} event_t;
+	// Records every button change and changed axis of each input report,
+	// in order, into events, a ring of count entries (a power of 2), so a
+	// press and release between two reads are both kept.  The queue takes
+	// the report like attachEvent(), so available() stays false.  NULL
+	// stops recording.
+	void	 attachQueue(event_t *events, uint16_t count);
+	// Takes the oldest recorded change, false when there is none.  Only one
+	// reader, never from the USB host interrupt.
+	bool	 readEvent(event_t &event);
+	// Changes that found the queue full.  getButtons() and getAxis() still
+	// have the latest values.
+	uint32_t droppedEvents() { return queue_dropped_; }
+
 	// PS3 pair function. hack, requires that it be connect4ed by USB and we have the address of the Bluetooth dongle...
 	bool PS3Pair(uint8_t* bdaddr);
 
@@ -964,7 +990,19 @@ private:
 	bool transmitPS3UserFeedbackMsg();
 	bool transmitPS3MotionUserFeedbackMsg();
 	bool mapNameToJoystickType(const uint8_t *remoteName);
-
+	void event_ready(bool changed = true);
+	void queue_event(uint32_t time, uint8_t axis, int32_t value);
+
+	void (*eventCallback)(JoystickController &joystick, uint64_t changed_axes,
+		uint32_t pressed, uint32_t released) = nullptr;
+	uint32_t event_buttons_ = 0;	// buttons at the last event
+	// event queue, head written by the USB host interrupt, tail by readEvent()
+	event_t *queue_ = nullptr;
+	uint16_t queue_mask_ = 0;
+	volatile uint16_t queue_head_ = 0;
+	volatile uint16_t queue_tail_ = 0;
+	volatile uint32_t queue_dropped_ = 0;
+	uint32_t queue_buttons_ = 0;	// buttons in the last queued event
 	bool anychange = false;
 	volatile bool joystickEvent = false;
 	uint32_t buttons = 0;
@@ -385,6 +385,7 @@ void JoystickController::disconnect_collection(Device_t *dev)
 		driver_ = nullptr;
 		axis_mask_ = 0;	
 		axis_changed_mask_ = 0;
+		event_buttons_ = 0;
 	}
 }
 
@@ -452,7 +453,7 @@ void JoystickController::hid_input_data(uint32_t usage, int32_t value)
 void JoystickController::hid_input_end()
 {
 	if (anychange) {
-		joystickEvent = true;
+		event_ready();
 	}
 }
 
@@ -469,6 +470,84 @@ void JoystickController::joystickDataClear() {
 	axis_mask_ = 0;
 }
 
+// An input report arrived.  With an event queue or an attachEvent()
+// function they get the changes right away and take the event, so
+// available() stays false and the next report starts a new changed mask.
+// A report that changed nothing only sets available() for sketches that
+// use neither.
+void JoystickController::event_ready(bool changed)
+{
+	if (!changed) {
+		if (eventCallback == nullptr && queue_ == nullptr) joystickEvent = true;
+		return;
+	}
+	joystickEvent = true;
+	if (queue_) {
+		uint32_t now = ARM_DWT_CYCCNT;
+		if (buttons != queue_buttons_) {
+			queue_buttons_ = buttons;
+			queue_event(now, EVENT_BUTTONS, buttons);
+		}
+		for (uint64_t changed = axis_changed_mask_; changed; changed &= changed - 1) {
+			uint8_t i = __builtin_ctzll(changed);
+			queue_event(now, i, axis[i]);
+		}
+	}
+	if (eventCallback) {
+		uint32_t pressed = buttons & ~event_buttons_;
+		uint32_t released = event_buttons_ & ~buttons;
+		event_buttons_ = buttons;
+		(*eventCallback)(*this, axis_changed_mask_, pressed, released);
+	} else if (queue_ == nullptr) {
+		return;
+	}
+	joystickEvent = false;
+	anychange = false;
+	axis_changed_mask_ = 0;
+}
+
+void JoystickController::attachQueue(event_t *events, uint16_t count)
+{
+	queue_ = nullptr;
+	if (events == nullptr || count == 0) return;
+	while (count & (count - 1)) count &= count - 1;
+	if (count > 0x8000) count = 0x8000;
+	queue_mask_ = count - 1;
+	queue_head_ = queue_tail_ = 0;
+	queue_dropped_ = 0;
+	queue_buttons_ = buttons;
+	__asm__ volatile("" ::: "memory");
+	queue_ = events;
+}
+
+// Producer side of the queue, the only writer of queue_head_
+void JoystickController::queue_event(uint32_t time, uint8_t axis, int32_t value)
+{
+	uint16_t h = queue_head_;
+	if ((uint16_t)(h - queue_tail_) > queue_mask_) {
+		queue_dropped_++;
+		return;
+	}
+	event_t *e = &queue_[h & queue_mask_];
+	e->time = time;
+	e->axis = axis;
+	e->value = value;
+	__asm__ volatile("" ::: "memory");
+	queue_head_ = h + 1;
+}
+
+// Consumer side of the queue, the only writer of queue_tail_
+bool JoystickController::readEvent(event_t &event)
+{
+	uint16_t t = queue_tail_;
+	if (queue_ == nullptr || t == queue_head_) return false;
+	__asm__ volatile("" ::: "memory");
+	event = queue_[t & queue_mask_];
+	__asm__ volatile("" ::: "memory");
+	queue_tail_ = t + 1;
+	return true;
+}
+
 //*****************************************************************************
 // Support for Joysticks that are class specific and do not use HID
 // Example: XBox One controller. 
@@ -657,7 +736,6 @@ void JoystickController::rx_data(const Transfer_t *transfer)
 			if (xb1d->buttons != buttons) {
 				buttons = xb1d->buttons;
 				anychange = true;
-				joystickEvent = true;
 				println("  Button Change: ", buttons, HEX);
 			}
 			for (uint8_t i = 0; i < sizeof (xbox_axis_order_mapping); i++) {
@@ -669,7 +747,7 @@ void JoystickController::rx_data(const Transfer_t *transfer)
 					anychange = true;
 				}
 			}
-			joystickEvent = true;
+			event_ready(anychange);
 		}
 
 	} else if (joystickType_ == XBOX360) {
@@ -722,7 +800,7 @@ void JoystickController::rx_data(const Transfer_t *transfer)
 				anychange = true;
 			}
 
-			if (anychange) joystickEvent = true;
+			if (anychange) event_ready();
 		}
 	}
 
@@ -737,6 +815,7 @@ void JoystickController::disconnect()
 {
 	axis_mask_ = 0;	
 	axis_changed_mask_ = 0;
+	event_buttons_ = 0;
 	// TODO: free resources
 }
 
@@ -782,7 +861,7 @@ bool JoystickController::process_bluetooth_HID_data(const uint8_t *data, uint16_
 			uint32_t cur_buttons = data[2] | ((uint16_t)data[3] << 8) | ((uint32_t)data[4] << 16); 
 			if (cur_buttons != buttons) {
 				buttons = cur_buttons;
-				joystickEvent = true;	// something changed.
+				anychange = true;	// something changed.
 			}
 
 			uint64_t mask = 0x1;
@@ -824,7 +903,7 @@ bool JoystickController::process_bluetooth_HID_data(const uint8_t *data, uint16_
 			uint32_t cur_buttons = data[1] | ((uint16_t)data[2] << 8) | ((uint32_t)data[3] << 16); 
 			if (cur_buttons != buttons) {
 				buttons = cur_buttons;
-				joystickEvent = true;	// something changed.
+				anychange = true;	// something changed.
 			}
 
 			// Hard to know what is best here. for now just copy raw data over... 
@@ -867,8 +946,8 @@ bool JoystickController::process_bluetooth_HID_data(const uint8_t *data, uint16_
 
 		}
 
-		if (axis_changed_mask_ & axis_change_notify_mask_)
-			joystickEvent = true;
+		if (anychange || (axis_changed_mask_ & axis_change_notify_mask_))
+			event_ready();
 		connected_ = true;
 		return true;
 
@@ -917,7 +996,7 @@ bool JoystickController::process_bluetooth_HID_data(const uint8_t *data, uint16_
 		uint32_t cur_buttons = tmp_data[7] | (tmp_data[10]) | ((tmp_data[6]*10)) | ((uint16_t)tmp_data[5] << 16) ; 
 		if (cur_buttons != buttons) {
 			buttons = cur_buttons;
-			joystickEvent = true;	// something changed.
+			anychange = true;	// something changed.
 		}
 		
 		mask = 0x1;
@@ -957,7 +1036,7 @@ bool JoystickController::process_bluetooth_HID_data(const uint8_t *data, uint16_
 		}
 		DBGPrintf("\n");
 		//DBGPrintf("Axis Mask (axis_mask_, axis_changed_mask_; %d, %d\n", axis_mask_,axis_changed_mask_);
-		joystickEvent = true;
+		event_ready(anychange || axis_changed_mask_);
 		connected_ = true;
 	}
 	return false;